@@ -0,0 +1,290 @@
+#include "ChartModel.h"
+#include "StateMachineManager.h"
+
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+namespace scm {
+
+const string done_state_prefix = "done.state.";
+extern size_t splitStringToVector (std::string const &valstr, std::vector<std::string> &val, size_t max_s=0xffffffff, std::string const&separators=", \t");
+
+namespace {
+    struct TransitionAttrEventLess
+    {
+        bool operator () (TransitionAttr const *lhs, TransitionAttr const *rhs) const
+        {
+            return lhs->event_id_ < rhs->event_id_;
+        }
+    };
+}
+
+void ChartModel::collect_states (State *state, vector<State *> &states)
+{
+    states.push_back (state);
+    for (size_t i=0; i < state->substates_.size (); ++i) {
+        collect_states (state->substates_[i], states);
+    }
+}
+
+ChartModel::ChartModel (StateMachineManager *manager, StateMachine *mach)
+    : scxml_id_(mach->scxml_id ())
+{
+    vector<State *> states;
+    collect_states (mach, states);
+
+    size_t num = states.size ();
+    state_ids_.resize (num);
+    state_uids_.resize (num);
+    parent_.resize (num, -1);
+    history_type_.resize (num);
+    initial_state_.resize (num);
+    initial_transition_.resize (num, 0);
+    onentry_action_.resize (num);
+    onexit_action_.resize (num);
+    frame_move_action_.resize (num);
+    done_event_id_.resize (num, 0);
+    onentry_slot_.resize (num, -1);
+    onexit_slot_.resize (num, -1);
+    frame_move_slot_.resize (num, -1);
+    optional_slots_.resize (num, 0);
+    clear_history_slot_.resize (num, -1);
+    clear_deep_history_slot_.resize (num, -1);
+    transitions_.resize (num);
+    no_event_transitions_.resize (num);
+    transition_index_.resize (num);
+    subtree_events_.resize (num);
+    frame_work_.resize (num, 0);
+
+    for (size_t i=0; i < num; ++i) {
+        State *st = states[i];
+        st->state_index_ = (int)i;
+        state_ids_[i] = st->state_id ();
+        state_uids_[i] = st->state_uid ();
+        state_index_[st->state_uid ()] = (int)i;
+        // from now on ids are shared by the prototype and every instance
+        st->state_id_ = &state_ids_[i];
+        st->state_uid_ = &state_uids_[i];
+    }
+
+    for (size_t i=0; i < num; ++i) {
+        State *st = states[i];
+        string const &uid = state_uids_[i];
+        if (st->parent_) parent_[i] = st->parent_->state_index_;
+        history_type_[i] = manager->history_type (scxml_id_, uid);
+        initial_state_[i] = manager->initial_state_of_state (scxml_id_, uid);
+        onentry_action_[i] = manager->onentry_action (scxml_id_, uid);
+        onexit_action_[i] = manager->onexit_action (scxml_id_, uid);
+        frame_move_action_[i] = manager->frame_move_action (scxml_id_, uid);
+        done_event_id_[i] = manager->event_id (done_state_prefix + uid);
+
+        // number every slot name once, instances bind and connect by index
+        if (!onentry_action_[i].empty ()) {
+            onentry_slot_[i] = action_slot_names_.add (onentry_action_[i]);
+            if (onentry_action_[i] == "onentry_" + uid) optional_slots_[i] |= optional_onentry;
+        }
+        if (!onexit_action_[i].empty ()) {
+            onexit_slot_[i] = action_slot_names_.add (onexit_action_[i]);
+            if (onexit_action_[i] == "onexit_" + uid) optional_slots_[i] |= optional_onexit;
+        }
+        if (!frame_move_action_[i].empty ()) {
+            frame_move_slot_[i] = frame_move_slot_names_.add (frame_move_action_[i]);
+            if (frame_move_action_[i] == uid) optional_slots_[i] |= optional_frame_move;
+        }
+        clear_deep_history_slot_[i] = action_slot_names_.add ("clh(" + uid + "*)");
+        clear_history_slot_[i] = action_slot_names_.add ("clh(" + uid + ")");
+
+        vector<TransitionAttr *> attrs = manager->transition_attr (scxml_id_, uid);
+        if (!initial_state_[i].empty ()) {
+            initial_transition_[i] = new TransitionAttr ("", initial_state_[i]);
+            attrs.push_back (initial_transition_[i]);
+        }
+
+        for (size_t ti=0; ti < attrs.size (); ++ti) {
+            TransitionAttr *attr = attrs[ti];
+            attr->target_history_state_ = state_index (manager->history_id_resided_state (scxml_id_, attr->transition_target_));
+            attr->target_states_.clear ();
+            if (attr->target_history_state_ < 0) {
+                vector<string> targets;
+                splitStringToVector (attr->transition_target_, targets);
+                for (size_t si=0; si < targets.size (); ++si) {
+                    attr->target_states_.push_back (state_index (targets[si]));
+                }
+            }
+            attr->random_target_states_.resize (attr->random_target_.size ());
+            attr->random_target_history_state_.resize (attr->random_target_.size ());
+            for (size_t ri=0; ri < attr->random_target_.size (); ++ri) {
+                attr->random_target_states_[ri] = state_index (attr->random_target_[ri]);
+                attr->random_target_history_state_[ri] = state_index (manager->history_id_resided_state (scxml_id_, attr->random_target_[ri]));
+            }
+            resolve_path (st, states, attr->target_states_.empty () ? 0 : &attr->target_states_[0], attr->target_states_.size (), attr->path_);
+            attr->random_paths_.resize (attr->random_target_.size ());
+            for (size_t ri=0; ri < attr->random_target_.size (); ++ri) {
+                resolve_path (st, states, &attr->random_target_states_[ri], 1, attr->random_paths_[ri]);
+            }
+            if (attr == initial_transition_[i]) {
+                continue;
+            }
+            if (!attr->ontransit_.empty ()) {
+                attr->ontransit_slot_ = action_slot_names_.add (attr->ontransit_);
+            }
+            resolve_cond (st, attr);
+            attr->retain ();
+            if (attr->event_id_ == 0) {
+                no_event_transitions_[i].push_back (attr);
+            } else {
+                transitions_[i].push_back (attr);
+            }
+        }
+
+        // index transitions by event, stable sort keeps document order for cond fallthrough
+        vector<TransitionAttr *> &trans = transitions_[i];
+        std::stable_sort (trans.begin (), trans.end (), TransitionAttrEventLess ());
+        for (size_t ti=0; ti < trans.size (); ++ti) {
+            int e = trans[ti]->event_id_;
+            if (ti == 0 || trans[ti-1]->event_id_ != e) {
+                transition_index_[i][e] = std::make_pair (ti, ti+1);
+            } else {
+                transition_index_[i][e].second = ti+1;
+            }
+        }
+    }
+
+    no_event_cond_states_.resize (cond_slot_names_.size ());
+    for (size_t i=0; i < num; ++i) {
+        for (size_t ti=0; ti < no_event_transitions_[i].size (); ++ti) {
+            int slot = no_event_transitions_[i][ti]->cond_slot_;
+            if (slot < 0) continue;
+            vector<int> &users = no_event_cond_states_[slot];
+            if (users.empty () || users.back () != (int)i) users.push_back ((int)i);
+        }
+    }
+
+    // all done events are interned now, descendants come after their ancestors in document order.
+    size_t num_of_events = manager->num_of_events ();
+    for (size_t i=0; i < num; ++i) {
+        subtree_events_[i].resize (num_of_events);
+    }
+    for (size_t i=num; i-- > 0;) {
+        boost::dynamic_bitset<> &events = subtree_events_[i];
+        for (size_t ti=0; ti < transitions_[i].size (); ++ti) {
+            events.set (transitions_[i][ti]->event_id_);
+        }
+        if (dynamic_cast<Parallel *>(states[i])) {
+            // a parallel state listens to the done events of its regions
+            for (size_t si=0; si < states[i]->substates_.size (); ++si) {
+                events.set (done_event_id_[states[i]->substates_[si]->state_index_]);
+            }
+        }
+        if (!no_event_transitions_[i].empty ()) {
+            frame_work_[i] = 1;
+        }
+        if (parent_[i] >= 0) {
+            subtree_events_[parent_[i]] |= events;
+            frame_work_[parent_[i]] |= frame_work_[i];
+        }
+    }
+}
+
+ChartModel::~ChartModel ()
+{
+    for (size_t i=0; i < transitions_.size (); ++i) {
+        for (size_t ti=0; ti < transitions_[i].size (); ++ti) {
+            transitions_[i][ti]->release ();
+        }
+        for (size_t ti=0; ti < no_event_transitions_[i].size (); ++ti) {
+            no_event_transitions_[i][ti]->release ();
+        }
+        if (initial_transition_[i]) {
+            initial_transition_[i]->release ();
+        }
+    }
+}
+
+void ChartModel::resolve_cond (State *state, TransitionAttr *attr)
+{
+    attr->cond_slot_ = -1;
+    attr->in_state_.clear ();
+    attr->in_states_.clear ();
+    string const &cond = attr->cond_;
+    if (cond.empty ()) {
+        return;
+    }
+
+    string instate_check = cond.substr (0, 3);
+    if (instate_check != "In(" && instate_check != "in(") {
+        attr->cond_slot_ = cond_slot_names_.add (cond);
+        return;
+    }
+
+    // In(state1|state2), resolved relative to the state the transition belongs to
+    string::size_type endmark = cond.find_first_of (')', 4);
+    string st = cond.substr (3, endmark - 3);
+    vector<string> state_list;
+    size_t len = st.length();
+    size_t start_pos = 0;
+    for (size_t si=0; si < len; ++si) {
+        if (st[si] == '|') {
+            if (si-start_pos > 0) {
+                state_list.push_back(st.substr(start_pos,si-start_pos));
+                start_pos = si+1;
+            }
+        }
+    }
+    state_list.push_back(st.substr(start_pos));
+
+    for (size_t si=0; si < state_list.size(); ++si) {
+        State *s = state->findState(state_list[si]);
+        if (!s) {
+            assert (0 && "can't find state for In() check.");
+            continue;
+        }
+        attr->in_state_.push_back (s->state_uid ());
+        attr->in_states_.push_back (s->state_index_);
+    }
+    if (attr->in_states_.size () > 1) {
+        attr->in_mask_.resize (num_of_states ());
+        for (size_t si=0; si < attr->in_states_.size (); ++si) {
+            attr->in_mask_.set (attr->in_states_[si]);
+        }
+    }
+}
+
+void ChartModel::resolve_path (State *source, vector<State *> const &states, int const *targets, size_t count, TransitionPath &path)
+{
+    path.source_ = source->state_index_;
+    path.lca_ = -1;
+    path.entry_.clear ();
+
+    // same as State::changeState () does on an instance
+    State *lca = 0;
+    for (size_t i=0; i < count; ++i) {
+        if (targets[i] < 0) return; // a history, or not found
+        State *l = source->findLCA (states[targets[i]]);
+        if (!l || (lca && l != lca)) return;
+        lca = l;
+    }
+    if (!lca) return;
+
+    for (size_t i=0; i < count; ++i) {
+        State *st = states[targets[i]];
+        path.entry_.push_back (st->state_index_);
+        for (State *p = st->parent_; p && p != lca; p = p->parent_) {
+            path.entry_.push_back (p->state_index_);
+        }
+    }
+    path.lca_ = lca->state_index_;
+}
+
+int ChartModel::state_index (string const &state_uid) const
+{
+    boost::unordered_map<string, int>::const_iterator it = state_index_.find (state_uid);
+    if (it == state_index_.end ()) {
+        return -1;
+    }
+    return it->second;
+}
+
+}
@@ -0,0 +1,180 @@
+#ifndef ChartModel_H
+#define ChartModel_H
+
+#include "RefCountObject.h"
+#include "SlotTable.h"
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/dynamic_bitset.hpp>
+
+namespace scm {
+
+struct TransitionAttr;
+struct TransitionPath;
+class State;
+class StateMachine;
+class StateMachineManager;
+
+/** ChartModel
+ * 一份 scxml 載入後編譯出來的不可變資料，同一 scxml_id 的所有 machine 共用。
+ * State 依 document order 編號，index 0 是 machine 本身，各項屬性都存在以 state index 為索引的陣列中。
+ * Compiled, immutable data of a loaded scxml, shared by every machine cloned from the same scxml_id.
+ * States are numbered in document order, index 0 is the machine itself, and every attribute lives in an array indexed by state index.
+ */
+class ChartModel: public RefCountObject
+{
+public:
+    typedef boost::unordered_map<int, std::pair<size_t, size_t> > transition_index_map; // event id -> [first, last) in transitions()
+
+    enum {
+        optional_onentry    = 1,
+        optional_onexit     = 2,
+        optional_frame_move = 4
+    };
+
+    ChartModel (StateMachineManager *manager, StateMachine *mach);
+
+    std::string const &scxml_id () const {
+        return scxml_id_;
+    }
+
+    size_t num_of_states () const {
+        return state_uids_.size ();
+    }
+
+    /** \brief state uid 對應的 index，找不到傳回 -1。 Index of state uid, -1 if not found. */
+    int state_index (std::string const &state_uid) const;
+
+    std::string const &state_id (int index) const {
+        return state_ids_[index];
+    }
+    std::string const &state_uid (int index) const {
+        return state_uids_[index];
+    }
+    int parent (int index) const {
+        return parent_[index];
+    }
+    bool has_history (int index) const {
+        return !history_type_[index].empty ();
+    }
+    std::string const &history_type (int index) const {
+        return history_type_[index];
+    }
+    std::string const &initial_state (int index) const {
+        return initial_state_[index];
+    }
+    /** \brief 進入 state 時走的 initial transition，沒有指定 initial 時為 0。 Transition taken to the initial state, 0 if no initial was given. */
+    TransitionAttr *initial_transition (int index) const {
+        return initial_transition_[index];
+    }
+    std::string const &onentry_action (int index) const {
+        return onentry_action_[index];
+    }
+    std::string const &onexit_action (int index) const {
+        return onexit_action_[index];
+    }
+    std::string const &frame_move_action (int index) const {
+        return frame_move_action_[index];
+    }
+    int done_event_id (int index) const {
+        return done_event_id_[index];
+    }
+
+    SlotNames const &action_slot_names () const {
+        return action_slot_names_;
+    }
+    SlotNames const &cond_slot_names () const {
+        return cond_slot_names_;
+    }
+    SlotNames const &frame_move_slot_names () const {
+        return frame_move_slot_names_;
+    }
+    /** \brief onentry action 在 action_slot_names() 中的編號，沒有時為 -1。 Index of onentry action in action_slot_names(), -1 if none. */
+    int onentry_slot (int index) const {
+        return onentry_slot_[index];
+    }
+    int onexit_slot (int index) const {
+        return onexit_slot_[index];
+    }
+    /** \brief frame_move 在 frame_move_slot_names() 中的編號，沒有時為 -1。 Index in frame_move_slot_names(), -1 if none. */
+    int frame_move_slot (int index) const {
+        return frame_move_slot_[index];
+    }
+    /** \brief 未設定 slot 時不算錯誤，也就是使用預設名稱的 onentry, onexit 或 frame_move。 Missing slot is not an error, i.e. default named onentry, onexit or frame_move. */
+    bool slot_optional (int index, int which) const {
+        return (optional_slots_[index] & which) != 0;
+    }
+    /** \brief "clh(state_uid)" 及 "clh(state_uid*)" 在 action_slot_names() 中的編號。 Index of "clh(state_uid)" and "clh(state_uid*)" in action_slot_names(). */
+    int clear_history_slot (int index) const {
+        return clear_history_slot_[index];
+    }
+    int clear_deep_history_slot (int index) const {
+        return clear_deep_history_slot_[index];
+    }
+    /** \brief 有 event 的 transitions，依 event 分組，同組內保持 document order。 Event transitions grouped by event, document order kept within a group. */
+    std::vector<TransitionAttr *> const &transitions (int index) const {
+        return transitions_[index];
+    }
+    std::vector<TransitionAttr *> const &no_event_transitions (int index) const {
+        return no_event_transitions_[index];
+    }
+    transition_index_map const &transition_index (int index) const {
+        return transition_index_[index];
+    }
+    /** 此 state 或其子 state 有 eventless transition，需要每個 frame 處理。frame_move slot 要到連接時才知道有沒有綁定，由 State::connectActionSlots() 另外標記。
+     * This state or a descendant has an eventless transition and needs work every frame. Whether a frame_move slot is bound is only known when connecting, State::connectActionSlots() marks those.
+     */
+    bool frame_work (int index) const {
+        return frame_work_[index] != 0;
+    }
+    /** \brief eventless transitions 用到 cond slot 的 states。 States whose eventless transitions use cond slot. */
+    std::vector<int> const &no_event_cond_states (int slot) const {
+        return no_event_cond_states_[slot];
+    }
+    /** \brief 此 state 及其子 state 會處理的 events。 Events handled by this state or any of its descendants. */
+    boost::dynamic_bitset<> const &subtree_events (int index) const {
+        return subtree_events_[index];
+    }
+
+protected:
+    virtual ~ChartModel ();
+
+private:
+    static void collect_states (State *state, std::vector<State *> &states);
+    void resolve_cond (State *state, TransitionAttr *attr);
+    static void resolve_path (State *source, std::vector<State *> const &states, int const *targets, size_t count, TransitionPath &path);
+
+    std::string                                scxml_id_;
+    std::vector<std::string>                   state_ids_;
+    std::vector<std::string>                   state_uids_;
+    boost::unordered_map<std::string, int>     state_index_;
+    std::vector<int>                           parent_;
+    std::vector<std::string>                   history_type_;
+    std::vector<std::string>                   initial_state_;
+    std::vector<TransitionAttr *>              initial_transition_;
+    std::vector<std::string>                   onentry_action_;
+    std::vector<std::string>                   onexit_action_;
+    std::vector<std::string>                   frame_move_action_;
+    std::vector<int>                           done_event_id_;
+    SlotNames                                  action_slot_names_;
+    SlotNames                                  cond_slot_names_;
+    SlotNames                                  frame_move_slot_names_;
+    std::vector<int>                           onentry_slot_;
+    std::vector<int>                           onexit_slot_;
+    std::vector<int>                           frame_move_slot_;
+    std::vector<unsigned char>                 optional_slots_;
+    std::vector<int>                           clear_history_slot_;
+    std::vector<int>                           clear_deep_history_slot_;
+    std::vector<std::vector<TransitionAttr *> > transitions_;
+    std::vector<std::vector<TransitionAttr *> > no_event_transitions_;
+    std::vector<transition_index_map>          transition_index_;
+    std::vector<boost::dynamic_bitset<> >      subtree_events_;
+    std::vector<unsigned char>                 frame_work_;
+    std::vector<std::vector<int> >             no_event_cond_states_; // by cond slot
+};
+
+}
+
+#endif
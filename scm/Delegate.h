@@ -0,0 +1,189 @@
+#ifndef Delegate_H
+#define Delegate_H
+
+#include <list>
+#include <utility>
+#include "InlineFunction.h"
+#include <boost/signals2.hpp>
+
+namespace bs2 = boost::signals2;
+
+namespace scm {
+
+/** DelegateSlots
+ * 單執行緒用的 slot 列表。第一個 slot 存在物件內，沒有 slot 或只有一個 slot 時呼叫不需配置記憶體也不用上鎖。
+ * 呼叫中可以 connect 或 disconnect，呼叫中 connect 的 slot 同一次呼叫就會被呼叫到。
+ * Single threaded slot list. The first slot is kept inline, so calling with zero or one slot never allocates nor locks.
+ * Slots may be connected or disconnected while calling, slots connected during a call are called in the same call.
+ */
+template <typename Sig> class DelegateSlots
+{
+public:
+    typedef InlineFunction<Sig>  slot_type;
+    typedef size_t               connection; // 0 is never a valid connection
+
+    DelegateSlots ()
+        : first_id_(0)
+        , next_id_(1)
+        , calling_(0)
+        , removed_(false)
+    {
+    }
+
+    connection connect (slot_type const &slot)
+    {
+        connection c = next_id_++;
+        if (!first_id_ && !first_) {
+            first_ = slot;
+            first_id_ = c;
+        } else {
+            rest_.push_back (std::make_pair (c, slot));
+        }
+        return c;
+    }
+
+    void disconnect (connection c)
+    {
+        if (!c) return;
+        if (first_id_ == c) {
+            first_id_ = 0;
+        } else {
+            typename slot_list::iterator it = rest_.begin ();
+            for (; it != rest_.end (); ++it) {
+                if (it->first == c) {
+                    it->first = 0;
+                    break;
+                }
+            }
+        }
+        removed_ = true;
+        if (!calling_) compact ();
+    }
+
+    void disconnect_all_slots ()
+    {
+        first_id_ = 0;
+        for (typename slot_list::iterator it = rest_.begin (); it != rest_.end (); ++it) {
+            it->first = 0;
+        }
+        removed_ = true;
+        if (!calling_) compact ();
+    }
+
+    bool empty () const
+    {
+        return num_slots () == 0;
+    }
+
+    size_t num_slots () const
+    {
+        size_t n = first_id_ ? 1 : 0;
+        for (typename slot_list::const_iterator it = rest_.begin (); it != rest_.end (); ++it) {
+            if (it->first) ++n;
+        }
+        return n;
+    }
+
+protected:
+    typedef std::list<std::pair<connection, slot_type> > slot_list;
+
+    // keeps the list stable while slots are being called, even if a slot throws.
+    struct CallGuard
+    {
+        DelegateSlots *slots_;
+        CallGuard (DelegateSlots *slots) : slots_(slots) { ++slots_->calling_; }
+        ~CallGuard () { if (--slots_->calling_ == 0 && slots_->removed_) slots_->compact (); }
+    };
+
+    template <typename Caller> void call_slots (Caller const &caller)
+    {
+        // outside of a call, rest_ is never used without first_
+        if (!first_id_) return;
+        CallGuard guard (this);
+        caller (first_);
+        for (typename slot_list::iterator it = rest_.begin (); it != rest_.end (); ++it) {
+            if (it->first) caller (it->second);
+        }
+    }
+
+private:
+    void compact ()
+    {
+        removed_ = false;
+        for (typename slot_list::iterator it = rest_.begin (); it != rest_.end ();) {
+            if (it->first) {
+                ++it;
+            } else {
+                rest_.erase (it++);
+            }
+        }
+        if (!first_id_) {
+            first_.clear ();
+            if (!rest_.empty ()) {
+                first_.swap (rest_.front ().second);
+                first_id_ = rest_.front ().first;
+                rest_.pop_front ();
+            }
+        }
+    }
+
+    slot_type  first_;
+    connection first_id_;
+    slot_list  rest_;
+    connection next_id_;
+    int        calling_;
+    bool       removed_;
+
+    DelegateSlots (DelegateSlots const &);
+    DelegateSlots &operator= (DelegateSlots const &);
+};
+
+template <typename Sig> class DelegateList;
+
+template <> class DelegateList<void ()>: public DelegateSlots<void ()>
+{
+    struct Caller
+    {
+        void operator () (slot_type const &slot) const { slot (); }
+    };
+
+public:
+    void operator () ()
+    {
+        call_slots (Caller ());
+    }
+};
+
+template <typename A1> class DelegateList<void (A1)>: public DelegateSlots<void (A1)>
+{
+    typedef typename DelegateSlots<void (A1)>::slot_type slot_type;
+
+    struct Caller
+    {
+        A1 a1_;
+        Caller (A1 a1) : a1_(a1) {}
+        void operator () (slot_type const &slot) const { slot (a1_); }
+    };
+
+public:
+    void operator () (A1 a1)
+    {
+        this->call_slots (Caller (a1));
+    }
+};
+
+/** Signal
+ * State, StateMachine 及 FrameMover 上的 hooks 所用的型別。預設為 DelegateList，定義 SCM_USE_SIGNALS2 時為 boost::signals2::signal，
+ * 此時 connect() 傳回 bs2::connection 並可跨執行緒使用。使用 scm 的程式必須以相同的設定編譯。
+ * Type of hooks on State, StateMachine and FrameMover. DelegateList by default, boost::signals2::signal if SCM_USE_SIGNALS2 is defined,
+ * in which case connect() returns bs2::connection and is thread safe. Code using scm must be compiled with the same setting.
+ */
+#ifdef SCM_USE_SIGNALS2
+template <typename Sig> class Signal: public bs2::signal<Sig> {};
+#else
+template <typename Sig> class Signal: public DelegateList<Sig> {};
+#endif
+
+}
+
+#endif
@@ -1,11 +1,12 @@
 #include "FrameMover.h"
+#include "TimerService.h"
 #include <algorithm>
 
 using namespace std;
 
 namespace scm {
 
-double  FrameMover::system_move_time_;
+TimerService *PunctualFrameMover::timers_;
 
 FrameMover::FrameMover ()
     : total_elapsed_time_(0)
@@ -22,7 +23,7 @@ void FrameMover::frame_move (float elapsed_seconds)
 {
     if (pause_) return;
     assert (!frame_moving_ && "Error! recursive frame_move() called");
-    total_elapsed_time_ += elapsed_seconds;
+    this->advance_time (elapsed_seconds);
     frame_moving_ = true;
     signal_on_frame_move_(elapsed_seconds);
     this->onFrameMove (elapsed_seconds);
@@ -73,59 +74,45 @@ void FrameMover::reset_time ()
 }
 
 
-namespace {
-struct TimedActionTypeCompare
+void PunctualFrameMover::bindTimerService (TimerService *timers)
 {
-    bool operator () (TimedActionType *lhs, TimedActionType *rhs) const
-    {
-        return lhs->time_ < rhs->time_;
-    }
-};
-
-std::list <TimedActionType *>   timed_acts_;
+    timers_ = timers;
+}
 
+TimerService *PunctualFrameMover::timerService ()
+{
+    return timers_;
 }
 
 TimedActionType * PunctualFrameMover::registerTimedAction (float after_t, boost::function<void()> act, bool cancelable)
 {
-    TimedActionType * p = new TimedActionType (after_t + system_move_time_, act, cancelable);
-
-    list <TimedActionType *>::iterator it = std::upper_bound (timed_acts_.begin (), timed_acts_.end (), p, TimedActionTypeCompare ());
-    timed_acts_.insert (it, p);
+    assert (timers_ && "no TimerService bound, see PunctualFrameMover::bindTimerService()");
+    if (!timers_) return 0;
+    double time = after_t + timers_->now ();
+    TimedActionType * p = 0;
+    if (cancelable) {
+        p = new TimedActionType (time, act, cancelable);
+    }
+    timers_->schedule (time, act, p);
 
     return p;
 }
 
-void PunctualFrameMover::clearTimedActions ()
+timer_handle PunctualFrameMover::scheduleTimedAction (float after_t, boost::function<void()> act)
 {
-    if (!timed_acts_.empty ()) {
-        list <TimedActionType *>::iterator it = timed_acts_.begin ();
-        list <TimedActionType *>::iterator it_end = timed_acts_.end ();
-        for (; it != it_end ; ++it) {
-            (*it)->release ();
-        }
-        timed_acts_.clear ();
-    }
+    assert (timers_ && "no TimerService bound, see PunctualFrameMover::bindTimerService()");
+    if (!timers_) return 0;
+    return timers_->schedule (after_t + timers_->now (), act);
 }
 
-void PunctualFrameMover::pumpTimers (double t)
+bool PunctualFrameMover::cancelTimedAction (timer_handle h)
 {
-    system_move_time_ += t;
-    // handle timed action
-    if (!timed_acts_.empty ()) {
-        list <TimedActionType *>::iterator it = timed_acts_.begin ();
-        for (; it != timed_acts_.end () ;) {
-            if ((*it)->time_ <= system_move_time_) {
-                if (!(*it)->cancelable_ || !(*it)->unique_ref ()) {
-                    (*it)->signal_ ();
-                }
-                (*it)->release ();
-                it = timed_acts_.erase (it);
-            } else {
-                break;
-            }
-        }
-    }
+    return timers_ && timers_->cancel (h);
+}
+
+void PunctualFrameMover::clearTimedActions ()
+{
+    if (timers_) timers_->clearActions ();
 }
 
 
@@ -2,20 +2,17 @@
 #define IFrameMover_H
 
 #include "RefCountObject.h"
+#include "Delegate.h"
+#include "TimerQueue.h"
 #include <string>
 #include <list>
-#include <boost/signals2.hpp>
-
-
-namespace bs2 = boost::signals2;
 
 namespace scm {
 
+class TimerService;
+
 class FrameMover: virtual public RefCountObject
 {
-protected:
-    static double    system_move_time_;
-
 protected:
     double total_elapsed_time_;
     bool pause_;
@@ -26,6 +23,10 @@ protected:
     virtual void onFrameMove (float elapsed_seconds) = 0;
     virtual void onPause() {}
     virtual void onResume() {}
+    /** \brief frame_move() 中累加 total_elapsed_time。 Accumulate total_elapsed_time in frame_move(). */
+    virtual void advance_time (float elapsed_seconds) {
+        total_elapsed_time_ += elapsed_seconds;
+    }
     
 public:
     FrameMover ();
@@ -41,21 +42,21 @@ public:
         return pause_;
     }
 
-    inline double total_elapsed_time () const {
+    virtual double total_elapsed_time () const {
         return this->total_elapsed_time_;
     }
 
     /** \brief reset total_elapsed_time to 0。*/
     virtual void reset_time ();
     
-    bs2::signal<void(float)> signal_on_frame_move_;
-    bs2::signal<void()> signal_on_pause_;
-    bs2::signal<void()> signal_on_resume_;
+    Signal<void(float)> signal_on_frame_move_;
+    Signal<void()> signal_on_pause_;
+    Signal<void()> signal_on_resume_;
 };
 
 /**
-PunctualFrameMover 讓使用者預訂未來某時間點呼叫某個動作。這邊以 signal/slot 的方式提供支援。
-PunctualFrameMover let user specify actions in the future. Support by utilize signal/slot mechanism.
+PunctualFrameMover 讓使用者預訂未來某時間點呼叫某個動作，由 bindTimerService() 指定的 TimerService 計時，時間只由其擁有者 (例如 StateMachineManager::pumpTimers()) 推進。
+PunctualFrameMover let user specify actions in the future, timed by the TimerService given to bindTimerService(). Time is only moved by its owner, StateMachineManager::pumpTimers() for example.
 @see PunctualFrameMover::registerTimedAction ()
 */
 struct TimedActionType: public RefCountObject
@@ -86,24 +87,34 @@ class PunctualFrameMover: public FrameMover
 {    
 	/** 在 after_t 秒後，執行動作 act。 如果cancelable為真，reference count > 1才執行動作。
 	* Execute act after after_t seconds, if cancelable is true, only perform action if reference count > 1.
-    * i.e, if cancelable is true, you must retain and release later the returned object.
+    * i.e, if cancelable is true, you must retain and release later the returned object, otherwise returns 0.
 	*/
 	static TimedActionType * registerTimedAction(float after_t, boost::function<void()> act, bool cancelable);
 
+    static TimerService *timers_;
+
 public:
+    /** 指定計時用的 TimerService，例如 StateMachineManager::timerService()。未指定時不能預訂動作。StateMachineManager 解構時若仍指定其 TimerService 會自動解除。
+     * Set the TimerService timing the actions, StateMachineManager::timerService() for example. No action can be scheduled until one is set.
+     * A StateMachineManager unbinds its TimerService on destruction if it is still bound.
+     */
+    static void bindTimerService (TimerService *timers);
+    static TimerService *timerService ();
+
 	// void return
 	static void registerTimedAction(float after_t, boost::function<void()> act) { registerTimedAction(after_t, act, false); }
 	// return reference counted object
 	static TimedActionType * registerTimedAction_cancelable(float after_t, boost::function<void()> act) { return registerTimedAction(after_t, act, true); }
+    /** 在 after_t 秒後執行 act，傳回的 handle 可用 cancelTimedAction() 立即取消，不需配置 TimedActionType。
+     * Execute act after after_t seconds. The returned handle cancels it at once by cancelTimedAction(), no TimedActionType is allocated.
+     */
+    static timer_handle scheduleTimedAction(float after_t, boost::function<void()> act);
+    static bool cancelTimedAction(timer_handle h);
 
     /** 清除所有未執行動作 
      * clear all timed actions
      */
     static void clearTimedActions ();
-    /**
-     * move 
-     */
-    static void pumpTimers (double t);
 };
 
 }
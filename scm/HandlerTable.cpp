@@ -0,0 +1,50 @@
+#include "HandlerTable.h"
+#include "ChartModel.h"
+
+#include <cassert>
+
+namespace scm {
+
+HandlerTable::HandlerTable (ChartModel *model)
+    : model_(model)
+    , type_(0)
+    , actions_(model->action_slot_names ().size (), (action_fn)0)
+    , conds_(model->cond_slot_names ().size (), (cond_fn)0)
+    , frame_moves_(model->frame_move_slot_names ().size (), (frame_move_fn)0)
+{
+    model_->retain ();
+}
+
+HandlerTable::~HandlerTable ()
+{
+    model_->release ();
+}
+
+void HandlerTable::check_type (std::type_info const &type)
+{
+    assert ((!type_ || *type_ == type) && "all handlers of a table must be of the same class");
+    type_ = &type;
+}
+
+void HandlerTable::setAction (std::string const &name, TypedHandler<action_fn> const &h)
+{
+    check_type (*h.type_);
+    int slot = model_->action_slot_names ().find (name);
+    if (slot >= 0) actions_[slot] = h.fn_;
+}
+
+void HandlerTable::setCond (std::string const &name, TypedHandler<cond_fn> const &h)
+{
+    check_type (*h.type_);
+    int slot = model_->cond_slot_names ().find (name);
+    if (slot >= 0) conds_[slot] = h.fn_;
+}
+
+void HandlerTable::setFrameMove (std::string const &name, TypedHandler<frame_move_fn> const &h)
+{
+    check_type (*h.type_);
+    int slot = model_->frame_move_slot_names ().find (name);
+    if (slot >= 0) frame_moves_[slot] = h.fn_;
+}
+
+}
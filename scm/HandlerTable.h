@@ -0,0 +1,152 @@
+#ifndef HandlerTable_H
+#define HandlerTable_H
+
+#include "RefCountObject.h"
+#include "InlineFunction.h"
+
+#include <string>
+#include <vector>
+#include <typeinfo>
+
+namespace scm {
+
+class ChartModel;
+
+/** TypedHandler
+ * 一個 handler 類別的 member function 轉成的普通函式，以及該類別的型別。由 SCM_HANDLER() 產生。
+ * Plain function calling a member function of a handler class, with the type of that class. Made by SCM_HANDLER().
+ */
+template <typename Fn> struct TypedHandler
+{
+    Fn                    fn_;
+    std::type_info const *type_;
+
+    TypedHandler (Fn fn, std::type_info const &type)
+        : fn_(fn), type_(&type)
+    {
+    }
+};
+
+/** HandlerTable
+ * 同一 scxml_id 的所有 machine 共用的 slot 表，存的是 handler 類別的 member functions。每個 machine 只需以 StateMachine::attachHandler() 指定自己的 handler 物件，
+ * 不必各自 bind slots。machine 自己設定的同名 slot 優先。以 StateMachineManager::handlerTable() 取得。
+ * Slot table of handler class member functions shared by every machine of a scxml_id. Each machine only attaches its own handler object by StateMachine::attachHandler()
+ * instead of binding slots one by one. Slots set on the machine itself take precedence. Get it by StateMachineManager::handlerTable().
+ */
+class HandlerTable: public RefCountObject
+{
+public:
+    typedef void (*action_fn) (void *handler);
+    typedef bool (*cond_fn) (void *handler);
+    typedef void (*frame_move_fn) (void *handler, float t);
+
+    explicit HandlerTable (ChartModel *model);
+
+    /** \brief 名稱不在 scxml 中時忽略。 Names not referenced by scxml are ignored. */
+    void setAction (std::string const &name, TypedHandler<action_fn> const &h);
+    void setCond (std::string const &name, TypedHandler<cond_fn> const &h);
+    void setFrameMove (std::string const &name, TypedHandler<frame_move_fn> const &h);
+
+    action_fn action (int slot) const {
+        return slot >= 0 ? actions_[slot] : 0;
+    }
+    cond_fn cond (int slot) const {
+        return slot >= 0 ? conds_[slot] : 0;
+    }
+    frame_move_fn frame_move (int slot) const {
+        return slot >= 0 ? frame_moves_[slot] : 0;
+    }
+
+    /** \brief handler 類別，還沒註冊任何 handler 時為 0。 Handler class, 0 if nothing registered yet. */
+    std::type_info const *handler_type () const {
+        return type_;
+    }
+
+protected:
+    virtual ~HandlerTable ();
+
+private:
+    void check_type (std::type_info const &type);
+
+    ChartModel                *model_;
+    std::type_info const      *type_;
+    std::vector<action_fn>     actions_;
+    std::vector<cond_fn>       conds_;
+    std::vector<frame_move_fn> frame_moves_;
+};
+
+/** BoundHandler
+ * HandlerTable 中的函式加上一個 machine 的 handler 物件，放得進 InlineFunction 不需配置記憶體。
+ * A function of HandlerTable with the handler object of one machine, fits in InlineFunction without allocation.
+ */
+template <typename R> struct BoundHandler0
+{
+    R   (*fn_) (void *);
+    void *handler_;
+
+    BoundHandler0 (R (*fn) (void *), void *handler) : fn_(fn), handler_(handler) {}
+    R operator () () const { return fn_ (handler_); }
+};
+
+template <typename R, typename A1> struct BoundHandler1
+{
+    R   (*fn_) (void *, A1);
+    void *handler_;
+
+    BoundHandler1 (R (*fn) (void *, A1), void *handler) : fn_(fn), handler_(handler) {}
+    R operator () (A1 a1) const { return fn_ (handler_, a1); }
+};
+
+// member function of C to plain function, see SCM_HANDLER()
+template <typename R, typename C> struct HandlerMaker0
+{
+    template <R (C::*M)()> static R call (void *h) { return (static_cast<C *>(h)->*M) (); }
+    template <R (C::*M)()> static TypedHandler<R (*)(void *)> make () { return TypedHandler<R (*)(void *)> (&call<M>, typeid (C)); }
+};
+
+template <typename R, typename C> struct ConstHandlerMaker0
+{
+    template <R (C::*M)() const> static R call (void *h) { return (static_cast<C const *>(h)->*M) (); }
+    template <R (C::*M)() const> static TypedHandler<R (*)(void *)> make () { return TypedHandler<R (*)(void *)> (&call<M>, typeid (C)); }
+};
+
+template <typename R, typename C, typename A1> struct HandlerMaker1
+{
+    template <R (C::*M)(A1)> static R call (void *h, A1 a1) { return (static_cast<C *>(h)->*M) (a1); }
+    template <R (C::*M)(A1)> static TypedHandler<R (*)(void *, A1)> make () { return TypedHandler<R (*)(void *, A1)> (&call<M>, typeid (C)); }
+};
+
+template <typename R, typename C, typename A1> struct ConstHandlerMaker1
+{
+    template <R (C::*M)(A1) const> static R call (void *h, A1 a1) { return (static_cast<C const *>(h)->*M) (a1); }
+    template <R (C::*M)(A1) const> static TypedHandler<R (*)(void *, A1)> make () { return TypedHandler<R (*)(void *, A1)> (&call<M>, typeid (C)); }
+};
+
+template <typename R, typename C> HandlerMaker0<R, C> handler_maker (R (C::*)()) { return HandlerMaker0<R, C> (); }
+template <typename R, typename C> ConstHandlerMaker0<R, C> handler_maker (R (C::*)() const) { return ConstHandlerMaker0<R, C> (); }
+template <typename R, typename C, typename A1> HandlerMaker1<R, C, A1> handler_maker (R (C::*)(A1)) { return HandlerMaker1<R, C, A1> (); }
+template <typename R, typename C, typename A1> ConstHandlerMaker1<R, C, A1> handler_maker (R (C::*)(A1) const) { return ConstHandlerMaker1<R, C, A1> (); }
+
+}
+
+/** \brief 把 member function 轉成 HandlerTable 用的函式，例如 SCM_HANDLER(&TheCandyMachine::releaseCandy)。
+ * Turn a member function into a function for HandlerTable, ex. SCM_HANDLER(&TheCandyMachine::releaseCandy).
+ */
+#define SCM_HANDLER(method) scm::handler_maker (method).make<method> ()
+
+#define REGISTER_STATE_HANDLER(table, state, onentry, onexit) \
+    { \
+    table->setAction ("onentry_" state, SCM_HANDLER (onentry)); \
+    table->setAction ("onexit_" state, SCM_HANDLER (onexit)); \
+    }
+
+#define REGISTER_ACTION_HANDLER(table, action, method) \
+	table->setAction (action, SCM_HANDLER (method));
+
+#define REGISTER_FRAME_MOVE_HANDLER(table, state, method) \
+	table->setFrameMove (state, SCM_HANDLER (method));
+
+#define REGISTER_COND_HANDLER(table, cond, method) \
+	table->setCond (cond, SCM_HANDLER (method));
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef InlineFunction_H
+#define InlineFunction_H
+
+#include <cassert>
+#include <new>
+#include <boost/function.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+namespace scm {
+
+/** InlineFunctionBase
+ * InlineFunction 的儲存空間。不大於 buffer_size 的 functor (例如 boost::bind 一個 member function 及物件指標) 直接存在物件內，不用配置記憶體，較大的才放在 heap。
+ * Storage of InlineFunction. Functors no larger than buffer_size (a member function bound to an object pointer by boost::bind, for example) are kept inline without allocation, only larger ones go to heap.
+ */
+class InlineFunctionBase
+{
+public:
+    enum { buffer_size = 4 * sizeof (void *) };
+
+    bool empty () const {
+        return manager_ == 0;
+    }
+
+protected:
+    union Buffer
+    {
+        void        *heap_;
+        long double  align_ld_;
+        void       (*align_f_)();
+        char         data_[buffer_size];
+    };
+
+    enum Op { op_clone, op_destroy };
+    typedef void (*manager_type) (Op op, Buffer &dst, Buffer const &src);
+
+    template <typename F> struct Manager
+    {
+        static bool const is_inline = sizeof (F) <= sizeof (Buffer)
+            && boost::alignment_of<F>::value <= boost::alignment_of<Buffer>::value;
+
+        static F *get (Buffer const &b)
+        {
+            if (is_inline) {
+                return reinterpret_cast<F *>(const_cast<char *>(b.data_));
+            }
+            return static_cast<F *>(b.heap_);
+        }
+
+        static void create (Buffer &dst, F const &f)
+        {
+            if (is_inline) {
+                new (static_cast<void *>(dst.data_)) F(f);
+            } else {
+                dst.heap_ = new F(f);
+            }
+        }
+
+        static void manage (Op op, Buffer &dst, Buffer const &src)
+        {
+            if (op == op_clone) {
+                create (dst, *get (src));
+            } else if (is_inline) {
+                get (dst)->~F();
+            } else {
+                delete get (dst);
+            }
+        }
+    };
+
+    InlineFunctionBase ()
+        : manager_(0)
+    {
+    }
+
+    ~InlineFunctionBase ()
+    {
+        destroy ();
+    }
+
+    void destroy ()
+    {
+        if (manager_) {
+            manager_ (op_destroy, buffer_, buffer_);
+            manager_ = 0;
+        }
+    }
+
+    void clone_from (InlineFunctionBase const &rhs)
+    {
+        if (rhs.manager_) {
+            rhs.manager_ (op_clone, buffer_, rhs.buffer_);
+        }
+        manager_ = rhs.manager_;
+    }
+
+    Buffer       buffer_;
+    manager_type manager_;
+
+private:
+    InlineFunctionBase (InlineFunctionBase const &);
+    InlineFunctionBase &operator= (InlineFunctionBase const &);
+};
+
+template <typename Sig> class InlineFunction;
+
+/** InlineFunction
+ * 用法同 boost::function，但小的 functor 不配置記憶體。用於 action, cond 及 frame_move slots。
+ * Used like boost::function, but small functors are never allocated. Used for action, cond and frame_move slots.
+ */
+template <typename R> class InlineFunction<R ()>: public InlineFunctionBase
+{
+    typedef R (*invoker_type) (Buffer const &b);
+    typedef void (InlineFunction::*bool_type) () const;
+
+    template <typename F> static R invoke (Buffer const &b)
+    {
+        return (*Manager<F>::get (b)) ();
+    }
+
+    invoker_type invoker_;
+
+public:
+    typedef R result_type;
+
+    InlineFunction ()
+        : invoker_(0)
+    {
+    }
+
+    InlineFunction (InlineFunction const &rhs)
+        : InlineFunctionBase ()
+        , invoker_(rhs.invoker_)
+    {
+        clone_from (rhs);
+    }
+
+    template <typename F> InlineFunction (F const &f)
+        : invoker_(0)
+    {
+        assign (f);
+    }
+
+    InlineFunction (boost::function<R ()> const &f)
+        : invoker_(0)
+    {
+        if (!f.empty ()) assign (f);
+    }
+
+    InlineFunction (R (*f) ())
+        : invoker_(0)
+    {
+        if (f) assign (f);
+    }
+
+    InlineFunction &operator= (InlineFunction const &rhs)
+    {
+        if (this != &rhs) {
+            destroy ();
+            clone_from (rhs);
+            invoker_ = rhs.invoker_;
+        }
+        return *this;
+    }
+
+    void swap (InlineFunction &rhs)
+    {
+        InlineFunction tmp (rhs);
+        rhs = *this;
+        *this = tmp;
+    }
+
+    void clear ()
+    {
+        destroy ();
+        invoker_ = 0;
+    }
+
+    operator bool_type () const
+    {
+        return manager_ ? &InlineFunction::bool_true : 0;
+    }
+
+    R operator () () const
+    {
+        assert (invoker_ && "call to empty InlineFunction");
+        return invoker_ (buffer_);
+    }
+
+private:
+    template <typename F> void assign (F const &f)
+    {
+        Manager<F>::create (buffer_, f);
+        manager_ = &Manager<F>::manage;
+        invoker_ = &invoke<F>;
+    }
+
+    void bool_true () const {}
+};
+
+template <typename R, typename A1> class InlineFunction<R (A1)>: public InlineFunctionBase
+{
+    typedef R (*invoker_type) (Buffer const &b, A1 a1);
+    typedef void (InlineFunction::*bool_type) () const;
+
+    template <typename F> static R invoke (Buffer const &b, A1 a1)
+    {
+        return (*Manager<F>::get (b)) (a1);
+    }
+
+    invoker_type invoker_;
+
+public:
+    typedef R result_type;
+
+    InlineFunction ()
+        : invoker_(0)
+    {
+    }
+
+    InlineFunction (InlineFunction const &rhs)
+        : InlineFunctionBase ()
+        , invoker_(rhs.invoker_)
+    {
+        clone_from (rhs);
+    }
+
+    template <typename F> InlineFunction (F const &f)
+        : invoker_(0)
+    {
+        assign (f);
+    }
+
+    InlineFunction (boost::function<R (A1)> const &f)
+        : invoker_(0)
+    {
+        if (!f.empty ()) assign (f);
+    }
+
+    InlineFunction (R (*f) (A1))
+        : invoker_(0)
+    {
+        if (f) assign (f);
+    }
+
+    InlineFunction &operator= (InlineFunction const &rhs)
+    {
+        if (this != &rhs) {
+            destroy ();
+            clone_from (rhs);
+            invoker_ = rhs.invoker_;
+        }
+        return *this;
+    }
+
+    void swap (InlineFunction &rhs)
+    {
+        InlineFunction tmp (rhs);
+        rhs = *this;
+        *this = tmp;
+    }
+
+    void clear ()
+    {
+        destroy ();
+        invoker_ = 0;
+    }
+
+    operator bool_type () const
+    {
+        return manager_ ? &InlineFunction::bool_true : 0;
+    }
+
+    R operator () (A1 a1) const
+    {
+        assert (invoker_ && "call to empty InlineFunction");
+        return invoker_ (buffer_, a1);
+    }
+
+private:
+    template <typename F> void assign (F const &f)
+    {
+        Manager<F>::create (buffer_, f);
+        manager_ = &Manager<F>::manage;
+        invoker_ = &invoke<F>;
+    }
+
+    void bool_true () const {}
+};
+
+/** MemberSlot
+ * 物件 (或其 smart pointer) 加上 member function，不經 boost::bind 也不需要 placeholder。由 make_slot() 產生。
+ * An object (or a smart pointer to it) with a member function, without boost::bind nor placeholders. Made by make_slot().
+ */
+template <typename R, typename O, typename M> struct MemberSlot0
+{
+    O obj_;
+    M method_;
+
+    MemberSlot0 (O const &obj, M method) : obj_(obj), method_(method) {}
+    R operator () () const { return ((*obj_).*method_) (); }
+};
+
+template <typename R, typename A1, typename O, typename M> struct MemberSlot1
+{
+    O obj_;
+    M method_;
+
+    MemberSlot1 (O const &obj, M method) : obj_(obj), method_(method) {}
+    R operator () (A1 a1) const { return ((*obj_).*method_) (a1); }
+};
+
+template <typename R, typename C, typename O>
+MemberSlot0<R, O, R (C::*)()> make_slot (R (C::*method)(), O const &obj)
+{
+    return MemberSlot0<R, O, R (C::*)()> (obj, method);
+}
+
+template <typename R, typename C, typename O>
+MemberSlot0<R, O, R (C::*)() const> make_slot (R (C::*method)() const, O const &obj)
+{
+    return MemberSlot0<R, O, R (C::*)() const> (obj, method);
+}
+
+template <typename R, typename C, typename A1, typename O>
+MemberSlot1<R, A1, O, R (C::*)(A1)> make_slot (R (C::*method)(A1), O const &obj)
+{
+    return MemberSlot1<R, A1, O, R (C::*)(A1)> (obj, method);
+}
+
+template <typename R, typename C, typename A1, typename O>
+MemberSlot1<R, A1, O, R (C::*)(A1) const> make_slot (R (C::*method)(A1) const, O const &obj)
+{
+    return MemberSlot1<R, A1, O, R (C::*)(A1) const> (obj, method);
+}
+
+typedef InlineFunction<void ()>      action_slot;
+typedef InlineFunction<bool ()>      cond_slot;
+typedef InlineFunction<void (float)> frame_move_slot;
+
+}
+
+#endif
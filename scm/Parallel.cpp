@@ -2,33 +2,44 @@
 #include "StateMachine.h"
 
 #include <cassert>
+#include <algorithm>
 
 using std::string;
 using std::vector;
 
 namespace scm {
 
-const string done_state_prefix = "done.state.";
-
 /////////
 Parallel::Parallel (std::string const& state_id, State* parent, StateMachine *machine)
     :State (state_id, parent, machine)
 {
 }
 
-Parallel *Parallel::clone (State *parent, StateMachine *m)
+Parallel::Parallel (Parallel const *prototype, State* parent, StateMachine *machine)
+    :State (prototype, parent, machine)
 {
-    Parallel *pa = new Parallel (state_id_, parent, m);
+}
 
-    pa->clone_data (this);
+Parallel *Parallel::clone (State *parent, StateMachine *m)
+{
+    Parallel *pa = this->clone_instance (parent, m);
 
     pa->autorelease ();
 
     return pa;
 }
 
+Parallel *Parallel::clone_instance (State *parent, StateMachine *m) const
+{
+    Parallel *pa = new (m->arena_) Parallel (this, parent, m);
+
+    pa->clone_data (this);
+
+    return pa;
+}
+
 
-void Parallel::onEvent (string const &e)
+void Parallel::onEvent (int e)
 {
     if (this->isLeavingState ()) return;
 
@@ -36,33 +47,28 @@ void Parallel::onEvent (string const &e)
         return;
     }
 
-    if (e.substr(0, done_state_prefix.size()) == done_state_prefix) {
-        string state_uid = e.substr (11);
-        if (!state_uid.empty()) {
-            this->finished_substates_.insert (state_uid);
+    for (size_t i=0; i < this->substates_.size (); ++i) {
+        if (substates_[i]->done_event_id_ == e) {
+            this->finished_substates_.insert (substates_[i]);
+            break;
         }
     }
 
-    for (size_t i=0; i < transitions_.size (); ++i) {
-        Transition const &tran = *transitions_[i];
-        if (tran.attr_->event_ == e) {
-            bool change = trig_cond (tran);
-            if (change) {
-                this->changeState (tran);
-                return;
-            }
-        }
+    if (this->trig_event_transition (e)) {
+        return;
     }
 
     for (size_t i=0; i < this->substates_.size (); ++i) {
-        this->substates_[i]->onEvent (e);
+        if (this->substates_[i]->handles_event (e)) {
+            this->substates_[i]->onEvent (e);
+        }
     }
 
     // this state come to an end
     if (this->finished_substates_.size () == this->substates_.size ()) {
         done_ = true;
         this->signal_done ();
-        machine_->enqueEvent (done_state_prefix + state_uid_);
+        machine_->enqueEvent (done_event_id_);
     }
 }
 
@@ -72,14 +78,14 @@ void Parallel::enterState (bool enter_substate)
     
     assert (!substates_.empty ());
 
-    if (parent_ && !machine_->history_type (parent_->state_uid()).empty ()) {
-        parent_->history_state_id_ = this->state_uid();
+    if (parent_ && machine_->model_->has_history (parent_->state_index_)) {
+        parent_->history_state_ = this;
     }
 
     finished_substates_.clear ();
 
     done_ = false;
-    active_ = true;
+    this->set_active (true);
     this->reset_time ();
 
     machine_->current_enter_state_ = this;
@@ -99,6 +105,12 @@ void Parallel::enterState (bool enter_substate)
     }
 }
 
+void Parallel::reset_runtime ()
+{
+    State::reset_runtime ();
+    finished_substates_.clear ();
+}
+
 void Parallel::doEnterState (std::vector<State *> &vps)
 {
     while (!vps.empty()) {
@@ -141,7 +153,9 @@ void Parallel::exitState ()
         substates_[i]->exitState ();
     }
 
-    active_ = false;
+    this->stop_time ();
+    this->stop_leaving ();
+    this->set_active (false);
 
     signal_onexit ();
 }
@@ -149,7 +163,7 @@ void Parallel::exitState ()
 bool Parallel::inState (std::string const& state_id, bool recursive) const
 {
     for (size_t i=0; i < this->substates_.size (); ++i) {
-        if (substates_[i]->state_id_ == state_id) {
+        if (substates_[i]->state_id () == state_id) {
             return true;
         }
     }
@@ -182,13 +196,19 @@ bool Parallel::inState (State const *state, bool recursive) const
     return false;
 }
 
-void Parallel::onFrameMove (float t)
+double Parallel::next_deadline () const
 {
-    if (this->isLeavingState()) {
-        if (this->check_leaving_state_finished (t)) return;
+    double d = local_deadline ();
+    for (size_t i=0; d > 0 && !pause_ && i < this->substates_.size (); ++i) {
+        if (this->substates_[i]->frame_work_) d = std::min (d, this->substates_[i]->next_deadline ());
     }
+    return d;
+}
 
+void Parallel::onFrameMove (float t)
+{
     for (size_t i=0; i < this->substates_.size (); ++i) {
+        if (!this->substates_[i]->frame_work_) continue;
         this->substates_[i]->frame_move (t);
         if (!this->active_) return;
     }
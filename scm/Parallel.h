@@ -17,18 +17,23 @@ public:
 
     virtual bool inState (std::string const& state_id, bool recursive=true) const;
     virtual bool inState (State const* state, bool recursive=true) const;
+    virtual double next_deadline () const;
 
     virtual Parallel *clone (State *parent, StateMachine *m);
 
 protected:
-    virtual void onEvent (std::string const &e);
+    Parallel (Parallel const *prototype, State* parent, StateMachine *machine);
+    virtual Parallel *clone_instance (State *parent, StateMachine *m) const;
+
+    virtual void onEvent (int e);
     virtual void enterState (bool enter_substate=true);
+    virtual void reset_runtime ();
     virtual void exitState ();
     virtual void doEnterState (std::vector<State *> &vps);
     virtual void onFrameMove (float t);
 
 
-    std::set<std::string>  finished_substates_;
+    std::set<State *>  finished_substates_;
 
 };
 
@@ -0,0 +1,139 @@
+#ifndef SlotTable_H
+#define SlotTable_H
+
+#include "InlineFunction.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <boost/unordered_map.hpp>
+
+namespace scm {
+
+/** SlotNames
+ * 一份 scxml 中用到的某一類 slot 名稱，依出現順序編號。由 ChartModel 建立。
+ * Slot names of one kind referenced by a scxml, numbered in order of appearance. Built by ChartModel.
+ */
+class SlotNames
+{
+public:
+    /** \brief name 的編號，沒有用到時傳回 -1。 Index of name, -1 if not referenced. */
+    int find (std::string const &name) const
+    {
+        boost::unordered_map<std::string, int>::const_iterator it = index_.find (name);
+        return it == index_.end () ? -1 : it->second;
+    }
+
+    int add (std::string const &name)
+    {
+        std::pair<boost::unordered_map<std::string, int>::iterator, bool> res = index_.insert (std::make_pair (name, (int)names_.size ()));
+        if (res.second) {
+            names_.push_back (name);
+        }
+        return res.first->second;
+    }
+
+    std::string const &name (int index) const {
+        return names_[index];
+    }
+
+    size_t size () const {
+        return names_.size ();
+    }
+
+private:
+    boost::unordered_map<std::string, int> index_;
+    std::vector<std::string>               names_;
+};
+
+/** SlotTable
+ * machine 中某一類 slot 的存放處。scxml 用到的名稱依 SlotNames 的編號存在陣列中，connect 時直接以編號取得；其他名稱存在 map 中。
+ * Storage of one kind of slot in a machine. Slots of names referenced by scxml are kept in an array by SlotNames index and fetched by index when connecting; other names go to a map.
+ */
+template <typename Slot> class SlotTable
+{
+public:
+    SlotTable ()
+        : names_(0)
+    {
+    }
+
+    /** \brief 換成另一份 SlotNames 編號，已設定的 slots 依名稱保留。 Renumber by another SlotNames, slots already set are kept by name. */
+    void bind_names (SlotNames const *names)
+    {
+        if (names == names_) return;
+        if (names_) {
+            for (size_t i=0; i < slots_.size (); ++i) {
+                if (slots_[i]) named_[names_->name ((int)i)] = slots_[i];
+            }
+        }
+        names_ = names;
+        slots_.clear ();
+        if (!names_) return;
+
+        slots_.resize (names_->size ());
+        typename std::map<std::string, Slot>::iterator it = named_.begin ();
+        while (it != named_.end ()) {
+            int index = names_->find (it->first);
+            if (index >= 0) {
+                slots_[index] = it->second;
+                named_.erase (it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void set (std::string const &name, Slot const &slot)
+    {
+        int index = names_ ? names_->find (name) : -1;
+        if (index >= 0) {
+            slots_[index] = slot;
+        } else {
+            named_[name] = slot;
+        }
+    }
+
+    void set (int index, Slot const &slot)
+    {
+        if (index >= 0) slots_[index] = slot;
+    }
+
+    bool get (std::string const &name, Slot &slot) const
+    {
+        int index = names_ ? names_->find (name) : -1;
+        if (index >= 0) {
+            if (!slots_[index]) return false;
+            slot = slots_[index];
+            return true;
+        }
+        typename std::map<std::string, Slot>::const_iterator it = named_.find (name);
+        if (it == named_.end ()) return false;
+        slot = it->second;
+        return true;
+    }
+
+    /** \brief 編號 index 的 slot，未設定時傳回 0。 Slot of index, 0 if not set. */
+    Slot const *find (int index) const
+    {
+        if (index < 0 || !slots_[index]) return 0;
+        return &slots_[index];
+    }
+
+    void clear ()
+    {
+        for (size_t i=0; i < slots_.size (); ++i) {
+            slots_[i].clear ();
+        }
+        named_.clear ();
+    }
+
+private:
+    SlotNames const            *names_;
+    std::vector<Slot>           slots_;
+    std::map<std::string, Slot> named_; // names not referenced by scxml
+};
+
+}
+
+#endif
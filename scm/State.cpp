@@ -12,38 +12,215 @@ using namespace std;
 
 namespace scm {
 
-const string done_state_prefix = "done.state.";
-extern size_t splitStringToVector (std::string const &valstr, std::vector<std::string> &val, size_t max_s=0xffffffff, std::string const&separators=", \t");
 
-struct State::PRIVATE
+struct State::PRIVATE: public ArenaObject
 {
     State       *self_;
-    Transition  *leaving_target_transition_;
+    TransitionAttr *leaving_attr_; // reused by every delayed exit, allocated on the first one
+    Transition   leaving_transition_;
+    timer_handle leaving_timer_; // in machine's timed events
+    double       leaving_deadline_; // machine timer time leaving_timer_ is due
+    double       leaving_remaining_; // seconds left while leaving_timer_ is suspended
     float        leaving_delay_;
-    float        leaving_elapsed_seconds_;
+    bool         leaving_;
+    bool         leaving_due_; // leaving_timer_ fired, waiting for StateMachine::pumpQueuedEvents ()
+    double       clock_; // machine time total_elapsed_time_ is up to
+    size_t       no_event_checked_; // StateMachine::config_version_ eventless transitions were last checked at
+    bool         no_event_dirty_; // a cond not polled was invalidated
+    bool         no_event_polled_; // some eventless transition has a cond checked every frame
+    std::string  id_;  // own state id and uid, only used until the chart is compiled
+    std::string  uid_;
 
     PRIVATE (State *state)
         : self_(state)
+        , leaving_attr_(0)
+        , leaving_transition_(0)
+        , leaving_timer_(0)
+        , leaving_deadline_(0)
+        , leaving_remaining_(0)
         , leaving_delay_(0)
-        , leaving_elapsed_seconds_(0)
-        , leaving_target_transition_(0)
+        , leaving_(false)
+        , leaving_due_(false)
+        , clock_(0)
+        , no_event_checked_(0)
+        , no_event_dirty_(true)
+        , no_event_polled_(true)
     {
     }
 
     ~PRIVATE ()
     {
+        if (leaving_attr_) leaving_attr_->release ();
     }
 
-    void connect_transitions_signal (std::vector<boost::shared_ptr<Transition> > &transitions);
-    void connect_transitions_conds (std::vector<boost::shared_ptr<Transition> > &transitions);
+    void begin_leaving (Transition const &transition, std::string const &target, int const *targets, size_t num_targets, TransitionPath const *path);
+    State *find_lca (int const *targets, size_t num_targets) const;
+    void stop_leaving ();
+    bool leaving_frozen () const;
+    void arm_leaving_timer ();
+    void cancel_leaving_timer ();
+    static void suspend_leaving (State *state);
+    static void resume_leaving (State *state);
+
+    void connect_transitions_signal (transition_list &transitions);
+    void connect_transitions_conds (transition_list &transitions);
+
+    // states skipped by frame_move () take their time from the machine when asked
+    double machine_clock () const
+    {
+        return self_->machine_->total_elapsed_time_;
+    }
+    bool time_frozen () const;
+    void sync_time ();
+    static void settle_subtree (State *state);
+    static void restart_subtree (State *state);
 };
 
+bool State::PRIVATE::time_frozen () const
+{
+    for (State const *s = self_; s && s != s->machine_; s = s->parent_) {
+        if (s->pause_) return true;
+    }
+    return !self_->active_;
+}
+
+void State::PRIVATE::sync_time ()
+{
+    double now = machine_clock ();
+    self_->total_elapsed_time_ += now - clock_;
+    clock_ = now;
+}
+
+void State::PRIVATE::begin_leaving (Transition const &transition, std::string const &target, int const *targets, size_t num_targets, TransitionPath const *path)
+{
+    if (!leaving_attr_) {
+        leaving_attr_ = new TransitionAttr ("", "");
+        leaving_transition_.attr_ = leaving_attr_;
+    }
+    TransitionAttr const *attr = transition.attr_;
+    leaving_attr_->event_ = attr->event_;
+    leaving_attr_->event_id_ = attr->event_id_;
+    leaving_attr_->transition_target_ = target;
+    leaving_attr_->target_states_.assign (targets, targets + num_targets);
+    if (path) {
+        leaving_attr_->path_ = *path;
+    } else {
+        leaving_attr_->path_.lca_ = -1;
+    }
+    leaving_transition_.ontransit_functor_ = transition.ontransit_functor_;
+
+    leaving_ = true;
+    leaving_due_ = false;
+    leaving_remaining_ = leaving_delay_;
+    if (!leaving_frozen ()) arm_leaving_timer ();
+}
+
+State *State::PRIVATE::find_lca (int const *targets, size_t num_targets) const
+{
+    State *lca = 0;
+    for (size_t i=0; i < num_targets; ++i) {
+        State *st = targets[i] >= 0 ? self_->machine_->getState (targets[i]) : 0;
+        if (!st) {
+            assert (0 && "can't find transition target state!");
+            continue;
+        }
+        State *l = self_->findLCA (st);
+        if (!l) {
+            assert (l && "can't find common ancestor state.");
+            return 0;
+        }
+        if (lca && l != lca) {
+            assert (0 && "multiple targets but can't find common ancestor.");
+            return 0;
+        }
+        lca = l;
+    }
+    return lca;
+}
+
+void State::PRIVATE::stop_leaving ()
+{
+    cancel_leaving_timer ();
+    leaving_ = false;
+    leaving_due_ = false;
+}
+
+bool State::PRIVATE::leaving_frozen () const
+{
+    for (State const *s = self_; s; s = s->parent_) {
+        if (s->pause_) return true;
+    }
+    return !self_->active_;
+}
+
+void State::PRIVATE::arm_leaving_timer ()
+{
+    if (leaving_delay_ < 0) return; // indefinite, until doLeaveAferDelay ()
+    StateMachine *mach = self_->machine_;
+    leaving_deadline_ = mach->timer_now () + leaving_remaining_;
+    leaving_timer_ = mach->schedule_leaving (self_->state_index_, leaving_deadline_);
+}
+
+void State::PRIVATE::cancel_leaving_timer ()
+{
+    if (leaving_timer_) {
+        self_->machine_->cancelTimedEvent (leaving_timer_);
+        leaving_timer_ = 0;
+    }
+}
+
+void State::PRIVATE::suspend_leaving (State *state)
+{
+    PRIVATE *p = state->private_;
+    if (p->leaving_timer_) {
+        p->leaving_remaining_ = std::max (0.0, p->leaving_deadline_ - state->machine_->timer_now ());
+        p->cancel_leaving_timer ();
+    }
+    for (size_t i=0; i < state->substates_.size (); ++i) {
+        State *sub = state->substates_[i];
+        if (sub->active_ && !sub->pause_) suspend_leaving (sub);
+    }
+}
+
+void State::PRIVATE::resume_leaving (State *state)
+{
+    PRIVATE *p = state->private_;
+    if (p->leaving_ && !p->leaving_timer_ && !p->leaving_due_ && !p->leaving_frozen ()) {
+        p->arm_leaving_timer ();
+    }
+    for (size_t i=0; i < state->substates_.size (); ++i) {
+        State *sub = state->substates_[i];
+        if (sub->active_ && !sub->pause_) resume_leaving (sub);
+    }
+}
+
+void State::PRIVATE::settle_subtree (State *state)
+{
+    state->private_->sync_time ();
+    for (size_t i=0; i < state->substates_.size (); ++i) {
+        State *sub = state->substates_[i];
+        if (sub->active_ && !sub->pause_) settle_subtree (sub);
+    }
+}
+
+void State::PRIVATE::restart_subtree (State *state)
+{
+    state->private_->clock_ = state->private_->machine_clock ();
+    for (size_t i=0; i < state->substates_.size (); ++i) {
+        State *sub = state->substates_[i];
+        if (sub->active_ && !sub->pause_) restart_subtree (sub);
+    }
+}
+
 
 State::State (std::string const& state_id, State* parent, StateMachine *machine)
-    : parent_(parent), current_state_(0), machine_(machine), depth_(0)
-    , is_a_final_(false), done_(false), active_(false), is_unique_state_id_(true), slots_ready_(false)
+    : machine_(machine), parent_(parent), current_state_(0), depth_(0)
+    , is_a_final_(false), done_(false), slots_ready_(false), active_(false), is_unique_state_id_(true), frame_work_(false)
+    , state_index_(-1), done_event_id_(0), history_state_(0), transition_index_(0), subtree_events_(0)
 {
     private_ = new PRIVATE(this);
+    state_id_ = &private_->id_;
+    state_uid_ = &private_->uid_;
 
     if (parent_) {
         this->depth_ = parent_->depth_ + 1;
@@ -53,6 +230,19 @@ State::State (std::string const& state_id, State* parent, StateMachine *machine)
     
 }
 
+State::State (State const *prototype, State* parent, StateMachine *machine)
+    : machine_(machine), parent_(parent), current_state_(0), depth_(prototype->depth_)
+    , is_a_final_(prototype->is_a_final_), done_(false), slots_ready_(false), active_(false), is_unique_state_id_(prototype->is_unique_state_id_), frame_work_(false)
+    , state_id_(prototype->state_id_), state_uid_(prototype->state_uid_)
+    , state_index_(prototype->state_index_), done_event_id_(0), history_state_(0)
+    , no_event_transitions_(ArenaAllocator<Transition>(machine->arena_)), transitions_(ArenaAllocator<Transition>(machine->arena_))
+    , transition_index_(0), subtree_events_(0)
+{
+    private_ = new (machine->arena_) PRIVATE(this);
+    private_->leaving_delay_ = prototype->private_->leaving_delay_;
+    machine_->state_list_[state_index_] = this;
+}
+
 State::~State ()
 {
     if (machine_) machine_->removeState (this);
@@ -64,32 +254,33 @@ State::~State ()
 void State::set_state_id(const string& id)
 {
     assert (!slots_ready_ && "slots ready, can't change state uid!");
-    if (slots_ready_) {
+    assert (state_id_ == &private_->id_ && "chart compiled, can't change state uid!");
+    if (slots_ready_ || state_id_ != &private_->id_) {
         return;
     }
     
-    if (!state_id_.empty() && machine_ != this) {
+    if (!private_->id_.empty() && machine_ != this) {
         machine_->removeState(this);
     }
     
-    state_id_ = id;
+    private_->id_ = id;
     
-    if (state_id_.empty()) { // anonymous state
+    if (private_->id_.empty()) { // anonymous state
         if (machine_ == this) {
-            state_id_ = "_root";
+            private_->id_ = "_root";
         } else {
             ostringstream stream;
             stream << "_st" << machine_->num_of_states();;
-            state_id_ = stream.str();
+            private_->id_ = stream.str();
         }
     } else {
-        is_unique_state_id_ = machine_->is_unique_id(state_id_);
+        is_unique_state_id_ = machine_->is_unique_id(private_->id_);
     }
 
     if (this->is_unique_state_id_) {
-        state_uid_ = this->state_id_;
+        private_->uid_ = private_->id_;
     } else {
-        state_uid_ = parent_->state_uid() + "." + this->state_id_;
+        private_->uid_ = parent_->state_uid() + "." + private_->id_;
     }
 
     if (machine_ != this) { // delay addState to after machine_ construction complete.
@@ -100,25 +291,47 @@ void State::set_state_id(const string& id)
 
 State *State::clone (State *parent, StateMachine *m)
 {
-    State *state = new State (state_id_, parent, m);
-
-    state->clone_data (this);
+    State *state = this->clone_instance (parent, m);
 
     state->autorelease ();
 
     return state;
 }
 
-void State::clone_data (State *rhs)
+State *State::clone_instance (State *parent, StateMachine *m) const
 {
+    State *state = new (m->arena_) State (this, parent, m);
+
+    state->clone_data (this);
+
+    return state;
+}
+
+size_t State::arena_size_hint (ChartModel const *model)
+{
+    size_t size = 0;
+    for (size_t i=1; i < model->num_of_states (); ++i) {
+        size += ArenaObject::allocation_size (sizeof (Parallel)) + ArenaObject::allocation_size (sizeof (PRIVATE));
+        size += (model->transitions (i).size () + model->no_event_transitions (i).size ()) * sizeof (Transition) + 2 * ArenaObject::allocation_size (0);
+    }
+    return size;
+}
+
+void State::clone_data (State const *rhs)
+{
+    substates_.reserve (rhs->substates_.size ());
     for (size_t i=0; i < rhs->substates_.size (); ++i) {
-        substates_.push_back (rhs->substates_[i]->clone (this, machine_));
-        substates_.back ()->retain ();
+        substates_.push_back (rhs->substates_[i]->clone_instance (this, machine_));
     }
-    depth_ = rhs->depth_;
-    is_a_final_ = rhs->is_a_final_;
-    private_->leaving_delay_ = rhs->private_->leaving_delay_;
-    is_unique_state_id_ = rhs->is_unique_state_id_;
+}
+
+void State::own_state_ids ()
+{
+    if (state_id_ == &private_->id_) return;
+    private_->id_ = *state_id_;
+    private_->uid_ = *state_uid_;
+    state_id_ = &private_->id_;
+    state_uid_ = &private_->uid_;
 }
 
 void State::machine_clear_substates ()
@@ -138,7 +351,7 @@ void  State::reset_history ()
     
     if (!machine_->with_history_) return;
 
-    if (!machine_->history_type(this->state_uid()).empty()) {
+    if (machine_->model_->has_history (state_index_)) {
         this->clearHistory ();
     }
 
@@ -153,11 +366,9 @@ bool State::trig_cond (Transition const &tran) const
         bool change = tran.cond_functor_();
         if (tran.attr_->not_) change = !change;
         return change;
-    } else if (!tran.attr_->in_state_.empty ()) {
-        bool change = false;
-        for (size_t i=0; i < tran.attr_->in_state_.size(); ++i) {
-            change |= machine_->inState (tran.attr_->in_state_[i]);
-        }
+    } else if (!tran.attr_->in_states_.empty ()) {
+        TransitionAttr const *attr = tran.attr_;
+        bool change = attr->in_mask_.empty () ? machine_->active_set_.test (attr->in_states_[0]) : machine_->active_set_.intersects (attr->in_mask_);
         if (tran.attr_->not_) change = !change;
         return change;
     } else {
@@ -169,14 +380,14 @@ void State::enterState (bool enter_substate)
 {
     if (active_) return;
     
-    if (parent_ && !machine_->history_type (parent_->state_uid()).empty ()) {
-        parent_->history_state_id_ = this->state_uid();
+    if (parent_ && machine_->model_->has_history (parent_->state_index_)) {
+        parent_->history_state_ = this;
     }
 
     this->reset_time ();
 
     this->done_ = false;
-    active_ = true;
+    this->set_active (true);
 
     machine_->current_enter_state_ = this;
     if (substates_.empty()) {
@@ -196,7 +407,7 @@ void State::enterState (bool enter_substate)
     if (is_a_final_ && parent_) {
         parent_->done_ = true;
         parent_->signal_done ();
-        machine_->enqueEvent (done_state_prefix + parent_->state_uid());
+        machine_->enqueEvent (parent_->done_event_id_);
     }
 }
 
@@ -208,13 +419,15 @@ void State::exitState ()
         this->current_state_->exitState ();
     }
 
-    active_ = false;
+    this->stop_time ();
+    this->stop_leaving ();
+    this->set_active (false);
     this->current_state_ = 0;
 
     signal_onexit ();
 }
 
-void State::onEvent (string const &e)
+void State::onEvent (int e)
 {
     if (this->done_) {
         return;
@@ -224,25 +437,39 @@ void State::onEvent (string const &e)
         return;
     }
 
-    for (size_t i=0; i < transitions_.size (); ++i) {
-        Transition const &tran = *transitions_[i];
-        if (tran.attr_->event_ == e) {
-            bool change = trig_cond (tran);
-            if (change) {
-                this->changeState (tran);
-                return;
-            }
-        }
+    if (this->trig_event_transition (e)) {
+        return;
     }
 
-    if (this->current_state_) {
+    if (this->current_state_ && this->current_state_->handles_event (e)) {
         this->current_state_->onEvent (e);
     }
 }
 
+bool State::trig_event_transition (int e)
+{
+    if (!transition_index_) {
+        return false;
+    }
+
+    ChartModel::transition_index_map::const_iterator it = transition_index_->find (e);
+    if (it == transition_index_->end ()) {
+        return false;
+    }
+
+    for (size_t i=it->second.first; i < it->second.second; ++i) {
+        Transition const &tran = transitions_[i];
+        if (trig_cond (tran)) {
+            this->changeState (tran);
+            return true;
+        }
+    }
+    return false;
+}
+
 string State::initial_state() const
 {
-    string const&inits = machine_->initial_state_of_state(state_uid());
+    string const&inits = machine_->model_->initial_state (state_index_);
     if (!inits.empty()) {
         return inits;
     } else if (!substates_.empty()) {
@@ -283,7 +510,7 @@ float State::leavingDelay () const
 
 bool State::isLeavingState () const
 {
-    return private_->leaving_target_transition_;
+    return private_->leaving_;
 }
 
 void State::setLeavingDelay (float delay)
@@ -291,14 +518,75 @@ void State::setLeavingDelay (float delay)
     private_->leaving_delay_ = delay;
 }
 
+void State::require_frame_move ()
+{
+    for (State *s = this; s && !s->frame_work_; s = s->parent_) {
+        s->frame_work_ = true;
+    }
+}
+
+double State::total_elapsed_time () const
+{
+    if (machine_ == this || private_->time_frozen ()) {
+        return total_elapsed_time_;
+    }
+    return total_elapsed_time_ + (private_->machine_clock () - private_->clock_);
+}
+
+void State::reset_time ()
+{
+    FrameMover::reset_time ();
+    if (machine_ != this) private_->clock_ = private_->machine_clock ();
+}
+
+void State::stop_time ()
+{
+    if (machine_ != this && !private_->time_frozen ()) private_->sync_time ();
+}
+
+void State::advance_time (float t)
+{
+    if (machine_ == this) {
+        FrameMover::advance_time (t);
+    } else {
+        private_->sync_time ();
+    }
+}
+
+void State::set_active (bool active)
+{
+    active_ = active;
+    if (state_index_ >= 0 && (size_t)state_index_ < machine_->active_set_.size ()) {
+        machine_->active_set_[state_index_] = active;
+    }
+    ++machine_->config_version_;
+}
+
+void State::stop_leaving ()
+{
+    private_->stop_leaving ();
+}
+
+void State::onPause ()
+{
+    if (machine_ != this && active_) PRIVATE::settle_subtree (this);
+    if (active_) PRIVATE::suspend_leaving (this);
+}
+
+void State::onResume ()
+{
+    if (machine_ != this && active_) PRIVATE::restart_subtree (this);
+    if (active_) PRIVATE::resume_leaving (this);
+}
+
 void State::clearHistory ()
 {
-    this->history_state_id_ = "";
+    this->history_state_ = 0;
 }
 
 void State::clearDeepHistory ()
 {
-    this->history_state_id_ = "";
+    this->history_state_ = 0;
     for (size_t i=0; i < this->substates_.size (); ++i) {
         this->substates_[i]->clearDeepHistory ();
     }
@@ -306,96 +594,69 @@ void State::clearDeepHistory ()
 
 void State::changeState (Transition const &transition)
 {
-    std::string target;
-    if (!transition.attr_->random_target_.empty ()) {
-        int index = rand()%transition.attr_->random_target_.size ();
-        target = transition.attr_->random_target_[index];
-    } else {
-        target = transition.attr_->transition_target_;
-    }
-
-    std::string const& corresponding_state = machine_->state_id_of_history(target);
-    if (!corresponding_state.empty()) {
-        State *st = machine_->getState (corresponding_state);
-        std::string const& h = st->history_state_id_;
-        if (!h.empty()) {
-            target = h;
-        } else  {
-            target = st->initial_state ();
+    TransitionAttr const *attr = transition.attr_;
+    std::string const *target = &attr->transition_target_;
+    int const *targets = attr->target_states_.empty () ? 0 : &attr->target_states_[0];
+    size_t num_targets = attr->target_states_.size ();
+    TransitionPath const *path = &attr->path_;
+    int history_state = attr->target_history_state_;
+    if (!attr->random_target_.empty ()) {
+        int index = rand()%attr->random_target_.size ();
+        target = &attr->random_target_[index];
+        targets = &attr->random_target_states_[index];
+        num_targets = 1;
+        path = &attr->random_paths_[index];
+        history_state = attr->random_target_history_state_[index];
+    }
+
+    if (history_state >= 0) {
+        // targets depend on the recorded history, resolved now
+        path = 0;
+        num_targets = 0;
+        State *st = machine_->getState (history_state);
+        TransitionAttr const *init = machine_->model_->initial_transition (history_state);
+        if (st->history_state_) {
+            target = &st->history_state_->state_uid ();
+            targets = &st->history_state_->state_index_;
+            num_targets = 1;
+        } else if (init) {
+            target = &init->transition_target_;
+            targets = init->target_states_.empty () ? 0 : &init->target_states_[0];
+            num_targets = init->target_states_.size ();
+        } else if (!st->substates_.empty ()) {
+            target = &st->substates_.front ()->state_uid ();
+            targets = &st->substates_.front ()->state_index_;
+            num_targets = 1;
         }
+    } else if (path->lca_ < 0 || path->source_ != state_index_) {
+        path = 0;
     }
 
     machine_->transition_source_state_ = this->state_uid();
-    machine_->transition_target_state_ = target;
-
-    if (!private_->leaving_target_transition_) {
-        if (private_->leaving_delay_ != 0) {
-            TransitionAttr *attr = new TransitionAttr (transition.attr_->event_, target);
-            private_->leaving_target_transition_ = new Transition(attr);
-            private_->leaving_target_transition_->setAttr (attr);
-            attr->release ();
-            if (!transition.attr_->ontransit_.empty ()) {
-                boost::function<void()> s;
-                if (this->machine_->GetActionSlot (transition.attr_->ontransit_, s)) {
-                    private_->leaving_target_transition_->signal_transit.connect (s);
-                }
-            }
-            return;
-        }
-    }
-    
-    vector<State *> newState;
-    
-    if (target.find(',') == string::npos) {
-        State *st = machine_->getState (target);
-        if (st) {
-            newState.push_back(st);
-        } else {
-            assert (0 && "can't find transition target state!");
-        }
-    } else {
-        vector<string> targets;
-        splitStringToVector(target, targets);
-        for (size_t i=0; i < targets.size(); ++i) {
-            State *st = machine_->getState (targets[i]);
-            if (st) {
-                newState.push_back(st);
-            } else {
-                assert (0 && "can't find transition target state!");
-            }
-        }
+    machine_->transition_target_state_ = *target;
+
+    if (!private_->leaving_ && private_->leaving_delay_ != 0) {
+        private_->begin_leaving (transition, *target, targets, num_targets, path);
+        return;
     }
     
-    if (newState.empty()) {
+    if (num_targets == 0) {
         assert (0 && "can't find transition target state!");
         return;
     }
 
-    State *lcaState = this->findLCA (newState[0]);
-
+    State *lcaState = path ? machine_->getState (path->lca_) : private_->find_lca (targets, num_targets);
     if (!lcaState) {
-        assert (lcaState && "can't find common ancestor state.");
         return;
     }
-    
-    // make sure they are in the same parallel state?
-    if (newState.size() > 1) {
-        for (size_t i=1; i < newState.size(); ++i) {
-            State *lca = this->findLCA (newState[i]);
-            if (lca != lcaState) {
-                assert (lca && "multiple targets but can't find common ancestor.");
-                return;
-            }
-        }
-    }
 
     machine_->leaf_states_.clear();
     
     // exit old states
-    if (newState.size() == 1 && lcaState == newState[0]) { // for reentering
+    if (num_targets == 1 && lcaState->state_index_ == targets[0]) { // for reentering
         machine_->transition_source_state_ = lcaState->state_uid();
         lcaState->exitState ();
-        transition.signal_transit ();
+        transition.transit ();
         lcaState->enterState ();
         return;
     } else if (lcaState->current_state_) {
@@ -404,20 +665,33 @@ void State::changeState (Transition const &transition)
     }
 
     // transition
-    transition.signal_transit ();
-
-    // enter new state
-    vector<State *> vps;
-    for (size_t i=0; i < newState.size(); ++i) {
-        vps.push_back (newState[i]);
-        State *parentstate = newState[i]->parent_;
-        while (parentstate && (parentstate != lcaState)) {
-            vps.push_back (parentstate);
-            parentstate = parentstate->parent_;
+    transition.transit ();
+
+    // enter new state, entering may take other transitions so each level has its own buffer
+    StateMachine *mach = machine_;
+    if (mach->enter_depth_ == mach->enter_paths_.size ()) {
+        mach->enter_paths_.push_back (std::vector<State *> ());
+    }
+    std::vector<State *> &vps = mach->enter_paths_[mach->enter_depth_];
+    vps.clear ();
+    if (path) {
+        for (size_t i=0; i < path->entry_.size (); ++i) {
+            vps.push_back (mach->getState (path->entry_[i]));
+        }
+    } else {
+        for (size_t i=0; i < num_targets; ++i) {
+            State *st = targets[i] >= 0 ? mach->getState (targets[i]) : 0;
+            if (!st) continue;
+            vps.push_back (st);
+            for (State *parentstate = st->parent_; parentstate && parentstate != lcaState; parentstate = parentstate->parent_) {
+                vps.push_back (parentstate);
+            }
         }
     }
 
+    ++mach->enter_depth_;
     lcaState->doEnterState (vps);
+    --mach->enter_depth_;
 }
 
 void State::doEnterState (std::vector<State *> &vps)
@@ -436,19 +710,18 @@ void State::doEnterState (std::vector<State *> &vps)
 
 void State::doEnterSubState()
 {
-    if (!this->history_state_id_.empty() && !machine_->history_type(this->state_uid()).empty()) {
-        this->current_state_ = machine_->getState (this->history_state_id_);
+    ChartModel const *model = machine_->model_;
+    if (this->history_state_ && model->has_history (state_index_)) {
+        this->current_state_ = this->history_state_;
         this->current_state_->enterState ();
     } else {
         if (!substates_.empty ()) {
-            const string &initial_state = machine_->initial_state_of_state(this->state_uid());
-            if (initial_state.empty ()) {
+            TransitionAttr *attr = model->initial_transition (state_index_);
+            if (!attr) {
                 this->current_state_ = this->substates_.front ();
                 this->current_state_->enterState ();
             } else {
-                TransitionAttr *attr = new TransitionAttr ("", initial_state);
                 Transition tran(attr);
-                attr->release ();
                 this->changeState (tran);
             }
         }
@@ -479,7 +752,7 @@ State *State::findLCA (State const* ots)
 bool State::inState (std::string const& state_id, bool recursive) const
 {
     if (!current_state_) return false;
-    if (current_state_->state_id_ == state_id) {
+    if (current_state_->state_id () == state_id) {
         return true;
     } else if (recursive) {
         return current_state_->inState (state_id, recursive);
@@ -494,7 +767,10 @@ bool State::inState (State const*state, bool recursive) const
     if (current_state_ == state) {
         return true;
     } else if (recursive) {
-        return current_state_->inState (state, recursive);
+        // an active state below this one
+        if (!state || !state->active_ || state->depth_ <= depth_) return false;
+        while (state->depth_ > depth_) state = state->parent_;
+        return state == this;
     } else {
         return false;
     }
@@ -508,24 +784,25 @@ void State::prepareActionCondSlots ()
 
     this->slots_ready_ = true;
 
-    std::vector<TransitionAttr *> const&tran_attrs = machine_->transition_attr(this->state_uid());
-    size_t size = tran_attrs.size ();
-    transitions_.reserve(size);
-    no_event_transitions_.reserve(size);
+    ChartModel const *model = machine_->model_;
+    done_event_id_ = model->done_event_id (state_index_);
+    transition_index_ = &model->transition_index (state_index_);
+    subtree_events_ = &model->subtree_events (state_index_);
+    if (model->frame_work (state_index_)) this->require_frame_move ();
+
+    std::vector<TransitionAttr *> const&tran_attrs = model->transitions (state_index_);
+    transitions_.reserve(tran_attrs.size ());
     for (size_t i=0; i < tran_attrs.size(); ++i) {
-        boost::shared_ptr<Transition> ptr (new Transition(tran_attrs[i]));
-        if (tran_attrs[i]->event_.empty()) {
-            no_event_transitions_.push_back (ptr);
-        } else {
-            transitions_.push_back (ptr);
-        }
+        transitions_.push_back (Transition (tran_attrs[i]));
     }
-    std::vector<boost::shared_ptr<Transition> > (transitions_).swap(transitions_);
-    std::vector<boost::shared_ptr<Transition> > (no_event_transitions_).swap(no_event_transitions_);
 
-    // add clear history action
-    this->machine_->setActionSlot ("clh(" + state_uid() + "*)", boost::bind(&State::clearDeepHistory, this));
-    this->machine_->setActionSlot ("clh(" + state_uid() + ")", boost::bind(&State::clearHistory, this));
+    std::vector<TransitionAttr *> const&no_event_attrs = model->no_event_transitions (state_index_);
+    no_event_transitions_.reserve(no_event_attrs.size ());
+    for (size_t i=0; i < no_event_attrs.size(); ++i) {
+        no_event_transitions_.push_back (Transition (no_event_attrs[i]));
+    }
+
+    this->register_history_slots ();
 
     for (size_t i=0; i < this->substates_.size (); ++i) {
         this->substates_[i]->prepareActionCondSlots ();
@@ -533,63 +810,61 @@ void State::prepareActionCondSlots ()
 
 }
 
+void State::register_history_slots ()
+{
+    // add clear history action
+    ChartModel const *model = machine_->model_;
+    this->machine_->action_slots_.set (model->clear_deep_history_slot (state_index_), make_slot(&State::clearDeepHistory, this));
+    this->machine_->action_slots_.set (model->clear_history_slot (state_index_), make_slot(&State::clearHistory, this));
+}
+
+void State::reset_runtime ()
+{
+    active_ = false;
+    done_ = false;
+    current_state_ = 0;
+    this->clearHistory ();
+    this->reset_time ();
+    private_->stop_leaving ();
+    private_->no_event_dirty_ = true;
+}
+
+void State::disconnect_slots ()
+{
+    signal_onentry.disconnect_all_slots ();
+    signal_onexit.disconnect_all_slots ();
+    signal_done.disconnect_all_slots ();
+    frame_move_slots_.clear ();
+
+    for (size_t i=0; i < transitions_.size (); ++i) {
+        transitions_[i].cond_functor_.clear ();
+        transitions_[i].ontransit_functor_.clear ();
+    }
+    for (size_t i=0; i < no_event_transitions_.size (); ++i) {
+        no_event_transitions_[i].cond_functor_.clear ();
+        no_event_transitions_[i].ontransit_functor_.clear ();
+    }
+}
+
 void State::connectCondSlots ()
 {
     private_->connect_transitions_conds(transitions_);
     private_->connect_transitions_conds(no_event_transitions_);
+    this->update_no_event_polling ();
 
     for (size_t i=0; i < this->substates_.size (); ++i) {
         this->substates_[i]->connectCondSlots ();
     }
 }
 
-void State::PRIVATE::connect_transitions_conds(vector< boost::shared_ptr< Transition > >& transitions)
+void State::PRIVATE::connect_transitions_conds(transition_list& transitions)
 {
+    StateMachine const *mach = self_->machine_;
     for (size_t i=0; i < transitions.size (); ++i) {
-        if (!transitions[i]->attr_->cond_.empty ()) {
-            std::string cond = transitions[i]->attr_->cond_;
-            std::string instate_check = cond.substr (0, 3);
-            if (instate_check == "In(" || instate_check == "in(") {
-                string::size_type endmark = cond.find_first_of (')', 4);
-                string st = cond.substr (3, endmark - 3);
-                vector<string> state_list;
-                size_t len = st.length();
-                size_t start_pos = 0;
-                for (size_t si=0; si < len; ++si) {
-                    if (st[si] == '|') {
-                        if (si-start_pos > 0) {
-                            state_list.push_back(st.substr(start_pos,si-start_pos));
-                            start_pos = si+1;
-                        }
-                    }
-                }
-                state_list.push_back(st.substr(start_pos));
-
-                for (size_t si=0; si < state_list.size(); ++si) {
-                    if (!self_->machine_->is_unique_id(state_list[si])) {
-                        State *s = self_->findState(state_list[si]);
-                        if (!s) {
-                            assert (0 && "can't find state for In() check.");
-                            continue;
-                        }
-                        state_list[si] = s->state_uid();
-                    } else {
-                        State *s = self_->findState(state_list[si]);
-                        if (!s) {
-                            assert (0 && "can't find state for In() check.");
-                            continue;
-                        }
-                    }
-                }
-                transitions[i]->attr_->in_state_ = state_list;
-            } else {
-                boost::function<bool()> s;
-                if (self_->machine_->GetCondSlot (cond, s)) {
-                    transitions[i]->cond_functor_ = s;
-                } else {
-                    assert (0 && "can't connect cond slot");
-                }
-            }
+        int slot = transitions[i].attr_->cond_slot_;
+        if (slot < 0) continue; // no cond, or In() checked by trig_cond ()
+        if (!mach->find_cond_slot (slot, transitions[i].cond_functor_)) {
+            assert (0 && "can't connect cond slot");
         }
     }
 
@@ -598,31 +873,33 @@ void State::PRIVATE::connect_transitions_conds(vector< boost::shared_ptr< Transi
 
 void State::connectActionSlots ()
 {
-    boost::function<void()> s;
-    string const&onentry = machine_->onentry_action(this->state_uid());
-    if (!onentry.empty ()) {
-        if (this->machine_->GetActionSlot (onentry, s)) {
+    action_slot s;
+    ChartModel const *model = machine_->model_;
+    int onentry = model->onentry_slot (state_index_);
+    if (onentry >= 0) {
+        if (machine_->find_action_slot (onentry, s)) {
             this->signal_onentry.connect (s);
-        } else if (onentry != "onentry_"+state_uid()) {
+        } else if (!model->slot_optional (state_index_, ChartModel::optional_onentry)) {
             assert (0 && "can't connect onentry slot");
         }
     }
 
-    string const&onexit = machine_->onexit_action(this->state_uid());
-    if (!onexit.empty ()) {
-        if (this->machine_->GetActionSlot (onexit, s)) {
+    int onexit = model->onexit_slot (state_index_);
+    if (onexit >= 0) {
+        if (machine_->find_action_slot (onexit, s)) {
             this->signal_onexit.connect (s);
-        } else if (onexit != "onexit_"+state_uid())  {
+        } else if (!model->slot_optional (state_index_, ChartModel::optional_onexit)) {
             assert (0 && "can't connect onexit slot");
         }
     }
 
-    string const &frame_move = machine_->frame_move_action(this->state_uid());
-    if (!frame_move.empty ()) {
-        boost::function<void(float)> sf;
-        if (this->machine_->GetFrameMoveSlot (frame_move, sf)) {
+    int frame_move = model->frame_move_slot (state_index_);
+    if (frame_move >= 0) {
+        frame_move_slot sf;
+        if (machine_->find_frame_move_slot (frame_move, sf)) {
             frame_move_slots_.push_back(sf);
-        } else if (frame_move != state_uid()) { // specified frame_move slot but not found
+            this->require_frame_move ();
+        } else if (!model->slot_optional (state_index_, ChartModel::optional_frame_move)) { // specified frame_move slot but not found
             assert (0 && "can't connect frame_move slot");
         }
     }
@@ -635,50 +912,43 @@ void State::connectActionSlots ()
     }
 }
 
-void State::PRIVATE::connect_transitions_signal(vector< boost::shared_ptr< Transition > >& transitions)
+void State::PRIVATE::connect_transitions_signal(transition_list& transitions)
 {
+    StateMachine const *mach = self_->machine_;
     for (size_t i=0; i < transitions.size (); ++i) {
-        if (!transitions[i]->attr_->ontransit_.empty ()) {
-            string const&tr = transitions[i]->attr_->ontransit_;
-            boost::function<void()> s;
-            if (self_->machine_->GetActionSlot (tr, s)) {
-                transitions[i]->signal_transit.connect (s);
-            } else {
-                assert (0 && "can't connect on_transit slot");
-            }
+        int slot = transitions[i].attr_->ontransit_slot_;
+        if (slot < 0) continue;
+        if (!mach->find_action_slot (slot, transitions[i].ontransit_functor_)) {
+            assert (0 && "can't connect on_transit slot");
         }
     }
 }
 
 void State::doLeaveAferDelay ()
 {
-    if (private_->leaving_target_transition_) {
+    if (private_->leaving_) {
+        private_->cancel_leaving_timer ();
         // change state
-        this->changeState (*private_->leaving_target_transition_);
-        delete private_->leaving_target_transition_;
-        private_->leaving_target_transition_ = 0;
-        private_->leaving_elapsed_seconds_ = 0;
+        this->changeState (private_->leaving_transition_);
+        private_->leaving_ = false;
+        private_->leaving_due_ = false;
     }
 }
 
-bool State::check_leaving_state_finished(float t)
+void State::leaving_timer_fired ()
 {
-    if (private_->leaving_delay_ < 0) return false;
-    private_->leaving_elapsed_seconds_ += t;
-    if (private_->leaving_elapsed_seconds_ >= private_->leaving_delay_) {
-        doLeaveAferDelay ();
-        return true;
-    }
-    return false;
+    private_->leaving_timer_ = 0;
+    private_->leaving_due_ = true;
 }
 
-void State::onFrameMove (float t)
+void State::finish_leaving ()
 {
-    if (this->isLeavingState()) {
-        if (this->check_leaving_state_finished (t)) return;
-    }
+    if (private_->leaving_due_) this->doLeaveAferDelay ();
+}
 
-    if (this->current_state_) {
+void State::onFrameMove (float t)
+{
+    if (this->current_state_ && this->current_state_->frame_work_) {
         this->current_state_->frame_move (t);
         if (!this->active_) return;
     }
@@ -692,17 +962,59 @@ void State::onFrameMove (float t)
     }
 }
 
+double State::local_deadline () const
+{
+    if (!active_ || pause_) return no_deadline ();
+    if (!frame_move_slots_.empty () || !signal_on_frame_move_.empty ()) return 0;
+    if (this->isLeavingState ()) return no_deadline (); // leaving_delay is a timed event of the machine
+    return this->no_events_pending () ? 0 : no_deadline ();
+}
+
+double State::next_deadline () const
+{
+    double d = local_deadline ();
+    if (d > 0 && this->current_state_ && this->current_state_->frame_work_ && !pause_) {
+        d = std::min (d, this->current_state_->next_deadline ());
+    }
+    return d;
+}
+
 void State::pumpNoEvents()
 {
     if (this->isLeavingState()) return;
-        
+    if (!this->no_events_pending ()) return;
+
+    size_t version = machine_->config_version_;
     for (size_t i=0; i < no_event_transitions_.size (); ++i) {
-        Transition const &tran = *no_event_transitions_[i];
+        Transition const &tran = no_event_transitions_[i];
         if (trig_cond (tran)) {
             this->changeState (tran);
             return;
         }
     }
+    private_->no_event_checked_ = version;
+    private_->no_event_dirty_ = false;
+}
+
+bool State::no_events_pending () const
+{
+    if (no_event_transitions_.empty ()) return false;
+    return private_->no_event_polled_ || private_->no_event_dirty_ || private_->no_event_checked_ != machine_->config_version_;
+}
+
+void State::invalidate_no_events ()
+{
+    private_->no_event_dirty_ = true;
+}
+
+void State::update_no_event_polling ()
+{
+    bool polled = false;
+    for (size_t i=0; i < no_event_transitions_.size () && !polled; ++i) {
+        int slot = no_event_transitions_[i].attr_->cond_slot_;
+        polled = slot >= 0 && machine_->cond_polled (slot);
+    }
+    private_->no_event_polled_ = polled;
 }
 
 }
@@ -5,63 +5,87 @@
 #include <vector>
 #include <list>
 #include <set>
-
 #include "RefCountObject.h"
 #include "FrameMover.h"
+#include "ChartModel.h"
+#include "StateArena.h"
 
 namespace scm {
 
 class StateMachine;
 
+/** TransitionPath
+ * 編譯 chart 時算好的 transition 路徑：離開 lca_ 目前的子 state，再進入 entry_ 中的 states。
+ * Transition path computed when the chart is compiled: exit the current substate of lca_, then enter the states in entry_.
+ */
+struct TransitionPath
+{
+    int              source_; // index of the state taking the transition
+    int              lca_; // -1 if the path is resolved when taken
+    std::vector<int> entry_; // states entered below lca_, State::doEnterState () takes them from the back
+
+    TransitionPath ()
+        : source_(-1), lca_(-1)
+    {
+    }
+};
+
 struct TransitionAttr: public RefCountObject
 {
     std::string              event_;
+    int                      event_id_; // interned event_, 0 for eventless transition
     std::string              transition_target_;
     std::vector<std::string> random_target_;
     std::string              cond_; // for later connecting slot
     std::string              ontransit_; // for later connecting slot
     std::vector<std::string> in_state_; // for inState check if not empty. You can use '|' to specify multiple states, ex. "In(state1|state2)"
     bool                     not_; // to support "!In(state)"
+    std::vector<int>         target_states_; // indices of transition_target_ states
+    std::vector<int>         random_target_states_; // index of each random_target_, -1 for a history id
+    int                      target_history_state_; // index of the state transition_target_ is a history of, -1 if not a history id
+    std::vector<int>         random_target_history_state_; // same as above for each random_target_
+    std::vector<int>         in_states_; // indices of in_state_ states
+    boost::dynamic_bitset<>  in_mask_; // in_states_ as a mask over state indices, only for more than one state
+    int                      cond_slot_; // index in ChartModel::cond_slot_names(), -1 for none or In()
+    int                      ontransit_slot_; // index in ChartModel::action_slot_names(), -1 for none
+    TransitionPath           path_; // to target_states_
+    std::vector<TransitionPath> random_paths_; // to each random_target_
 
     TransitionAttr (std::string const &e, std::string const &t)
-        : event_(e), transition_target_(t), not_(false)
+        : event_(e), event_id_(0), transition_target_(t), not_(false), target_history_state_(-1), cond_slot_(-1), ontransit_slot_(-1)
     {
     }
 };
 
+/** Transition
+ * 一個 machine 中 transition 的 runtime 資料，只有綁定的 slots。attr_ 由 ChartModel 持有。
+ * Runtime part of a transition in one machine, just the bound slots. attr_ is owned by ChartModel.
+ */
 struct Transition
 {
-    TransitionAttr       *attr_;
-    boost::function<bool()>  cond_functor_;
-    bs2::signal<void()> signal_transit;
+    TransitionAttr          *attr_;
+    cond_slot                cond_functor_;
+    action_slot              ontransit_functor_;
 
     Transition (TransitionAttr *attr)
         : attr_(attr)
     {
-        attr->retain();
-    }
-
-
-    ~Transition ()
-    {
-        if (attr_) attr_->release ();
-        attr_ = 0;
     }
 
-    void setAttr (TransitionAttr *attr)
+    void transit () const
     {
-        attr->retain ();
-        if (attr_) attr_->release ();
-        attr_ = attr;
+        if (ontransit_functor_) ontransit_functor_ ();
     }
 };
 
+typedef std::vector<Transition, ArenaAllocator<Transition> > transition_list;
+
 /** State
 以 scxml 為基礎。請參考 https://www.w3.org/TR/scxml/
 Based on scxml, please refer to https://www.w3.org/TR/scxml/
 */
 
-class State: public FrameMover
+class State: public FrameMover, public ArenaObject
 {
 protected:
     StateMachine *machine_;
@@ -74,24 +98,30 @@ protected:
 
     bool         active_;
     bool         is_unique_state_id_;
+    bool         frame_work_; // ChartModel::frame_work(), a bound frame_move slot or require_frame_move(), frame_move() skips this state if false
 
-    std::string  state_id_;
-    std::string  state_uid_;
+    std::string const *state_id_;  // points into ChartModel once compiled
+    std::string const *state_uid_;
+    int          state_index_; // index in ChartModel
+    int          done_event_id_; // id of "done.state." + state_uid_
 
     std::vector<State*> substates_;
-    std::string  history_state_id_;
+    State       *history_state_;
+
+    transition_list            no_event_transitions_;
+    transition_list            transitions_; // in the order of ChartModel::transitions()
 
-    std::vector<boost::shared_ptr<Transition> >    no_event_transitions_;
-    std::vector<boost::shared_ptr<Transition> >    transitions_;
+    ChartModel::transition_index_map const *transition_index_;
+    boost::dynamic_bitset<> const          *subtree_events_; // events this state or any of its descendants reacts to
 
-    std::vector<boost::function<void (float)> > frame_move_slots_;
+    std::vector<frame_move_slot> frame_move_slots_;
 
 
 public:
     // signals
-    bs2::signal<void()>      signal_done;
-    bs2::signal<void()>      signal_onentry;
-    bs2::signal<void()>      signal_onexit;
+    Signal<void()>           signal_done;
+    Signal<void()>           signal_onentry;
+    Signal<void()>           signal_onexit;
 
 public:
     State (std::string const& state_id, State* parent, StateMachine *machine);
@@ -104,16 +134,22 @@ public:
     
     inline std::string const & state_id () const
     {
-        return state_id_;
+        return *state_id_;
     }
     
     inline std::string const & state_uid() const
     {
-        return state_uid_;
+        return *state_uid_;
+    }
+
+    /** \brief state 在 ChartModel 中的編號。 Index of this state in ChartModel. */
+    inline int state_index () const
+    {
+        return state_index_;
     }
 
     virtual State *clone (State *parent, StateMachine *m);
-    void clone_data (State *rhs);
+    void clone_data (State const *rhs);
 
     inline bool done () const {
         return done_;
@@ -130,10 +166,20 @@ public:
     
     float leavingDelay () const;
     bool  isLeavingState () const;
-    bool  check_leaving_state_finished (float t);
     // set to < 0 for indefinite delay
     void  setLeavingDelay (float delay);
 
+    /** 沒有綁定 frame_move slot 也沒有 eventless transition 的 state 在 frame_move() 時略過，也不會呼叫其 signal_on_frame_move_。
+     * 在這種 state 上連接 signal_on_frame_move_ 後呼叫此函式，讓它及其 parent 每個 frame 都被處理。
+     * States without a bound frame_move slot nor eventless transition are skipped by frame_move(), their signal_on_frame_move_ isn't called either.
+     * Call this after connecting signal_on_frame_move_ of such a state, so it and its parents are handled every frame.
+     */
+    void  require_frame_move ();
+
+    /** \brief 進入此 state 後經過的時間，被略過的 frame 也算在內。 Time elapsed since this state was entered, including frames it was skipped. */
+    virtual double total_elapsed_time () const;
+    virtual void reset_time ();
+
     virtual void clearHistory ();
     virtual void clearDeepHistory ();
 
@@ -144,16 +190,45 @@ public:
     virtual bool inState (std::string const& state_id, bool recursive=true) const;
     virtual bool inState (State const* state, bool recursive=true) const;    
 
+    /** 距離此 state 或其 active 子 state 下次需要 frame_move() 還有幾秒。有 frame_move slot 或 eventless transition 時為 0，
+     * 不需要時為 no_deadline()。leaving_delay 是 machine 的 timed event，不在此計算。
+     * Seconds until this state or an active substate next needs frame_move(). 0 if there is a frame_move slot or eventless transition,
+     * no_deadline() if never. leaving_delay is a timed event of the machine and isn't counted here.
+     */
+    virtual double next_deadline () const;
+
+    /** \brief 此 state 或其子 state 是否可能處理 event e。 Whether this state or any descendant may react to event e. */
+    inline bool handles_event (int e) const {
+        return subtree_events_ && (size_t)e < subtree_events_->size () && subtree_events_->test (e);
+    }
+
     friend class Parallel;
     friend class StateMachine;
     friend class StateMachineManager;
+    friend class ChartModel;
 
 protected:
-    virtual void onEvent (std::string const &e);
+    /** \brief 由已編譯的 prototype 產生 instance 用的 state，只複製 runtime 需要的資料。 Instance state built from a compiled prototype, only runtime data is copied. */
+    State (State const *prototype, State* parent, StateMachine *machine);
+    /** \brief 同 clone()，但不 autorelease，由 parent 持有。 Same as clone() but not autoreleased, owned by parent. */
+    virtual State *clone_instance (State *parent, StateMachine *m) const;
+    /** \brief 由 model 產生的 instance 在 arena 中大約需要的 bytes。 Estimated arena bytes for an instance of model. */
+    static size_t arena_size_hint (ChartModel const *model);
+
+    virtual void onEvent (int e);
     virtual void enterState (bool enter_substate=true);
     virtual void exitState ();
 
     void doLeaveAferDelay ();
+    /** leaving_delay 由 machine 的 timed events 計時，到期時標記，之後在 StateMachine::pumpQueuedEvents() 中依序 finish_leaving()。
+     * leaving_delay is timed by the machine's timed events. When due it's marked, then finish_leaving() runs in order in StateMachine::pumpQueuedEvents().
+     */
+    void leaving_timer_fired ();
+    void finish_leaving ();
+    /** \brief 離開 state 時取消等待中的 leaving_delay。 Cancel a pending leaving_delay when leaving the state. */
+    void stop_leaving ();
+    /** \brief 把 ids 從 ChartModel 複製回自己身上。 Take back own copies of ids shared with ChartModel. */
+    void own_state_ids ();
 
     State *findLCA (State const* ots);
 
@@ -162,12 +237,39 @@ protected:
     virtual void connectActionSlots ();
 
     virtual void onFrameMove (float t);
+    virtual void advance_time (float t);
+    /** \brief 離開 state 時把時間停在目前的值。 Freeze total_elapsed_time at its current value when leaving the state. */
+    void stop_time ();
+    /** \brief 設定 active_ 並更新 machine 的 active configuration。 Set active_ and update the active configuration of machine. */
+    void set_active (bool active);
+    virtual void onPause ();
+    virtual void onResume ();
 
     void pumpNoEvents ();
+    /** 是否需要檢查 eventless transitions：In() 及無 cond 的只在 configuration 改變後檢查，cond slot 預設每個 frame 檢查，
+     * 以 StateMachine::setCondPolling() 關閉後只在 configuration 改變或 StateMachine::invalidateCond() 後檢查。
+     * Whether eventless transitions need checking: In() and unconditional ones only after a configuration change. Cond slots are checked every frame by default,
+     * after StateMachine::setCondPolling() turns that off only after a configuration change or StateMachine::invalidateCond().
+     */
+    bool no_events_pending () const;
+    void invalidate_no_events ();
+    void update_no_event_polling ();
+    /** \brief 只考慮自己不含子 state 的 next_deadline()。 next_deadline() of this state only, not substates. */
+    double local_deadline () const;
 
     virtual void reset_history ();
 
+    /** \brief 回到 engine 啟動前的狀態，不呼叫任何 slot，只處理自己不含子 state。
+     * Back to the condition before engine started without calling any slot, this state only, not substates.
+     */
+    virtual void reset_runtime ();
+    /** \brief 斷開已連接的 onentry, onexit, frame_move 及 transition slots。 Disconnect connected onentry, onexit, frame_move and transition slots. */
+    void disconnect_slots ();
+    void register_history_slots ();
+
     bool trig_cond (Transition const &tran) const;
+    /** \brief 找出 event e 第一個條件成立的 transition 並執行。 Take the first transition of event e whose cond holds. */
+    bool trig_event_transition (int e);
 
 private:
     struct PRIVATE;
@@ -0,0 +1,100 @@
+#include "StateArena.h"
+
+#include <cassert>
+#include <cstdlib>
+
+namespace scm {
+
+namespace {
+    // placed in front of every ArenaObject, also keeps the object maximally aligned
+    union ArenaHeader
+    {
+        StateArena  *arena_;
+        long double  align_ld_;
+        void        *align_p_;
+    };
+
+    const size_t arena_alignment = sizeof (ArenaHeader);
+
+    inline size_t align_up (size_t size)
+    {
+        return (size + arena_alignment - 1) / arena_alignment * arena_alignment;
+    }
+}
+
+StateArena::StateArena (size_t chunk_size)
+    : cur_(0)
+    , left_(0)
+    , chunk_size_(align_up (chunk_size ? chunk_size : 1))
+    , allocated_size_(0)
+{
+}
+
+StateArena::~StateArena ()
+{
+    for (size_t i=0; i < chunks_.size (); ++i) {
+        std::free (chunks_[i]);
+    }
+}
+
+void *StateArena::allocate (size_t size)
+{
+    size = align_up (size ? size : 1);
+    if (size > left_) {
+        size_t chunk_size = size > chunk_size_ ? size : chunk_size_;
+        char *chunk = static_cast<char *>(std::malloc (chunk_size));
+        if (!chunk) {
+            throw std::bad_alloc ();
+        }
+        chunks_.push_back (chunk);
+        cur_ = chunk;
+        left_ = chunk_size;
+    }
+
+    void *p = cur_;
+    cur_ += size;
+    left_ -= size;
+    allocated_size_ += size;
+    return p;
+}
+
+void *ArenaObject::operator new (size_t size)
+{
+    return operator new (size, (StateArena *)0);
+}
+
+void *ArenaObject::operator new (size_t size, StateArena *arena)
+{
+    ArenaHeader *header;
+    if (arena) {
+        header = static_cast<ArenaHeader *>(arena->allocate (sizeof (ArenaHeader) + size));
+        arena->retain ();
+    } else {
+        header = static_cast<ArenaHeader *>(::operator new (sizeof (ArenaHeader) + size));
+    }
+    header->arena_ = arena;
+    return header + 1;
+}
+
+void ArenaObject::operator delete (void *p)
+{
+    if (!p) return;
+    ArenaHeader *header = static_cast<ArenaHeader *>(p) - 1;
+    if (header->arena_) {
+        header->arena_->release ();
+    } else {
+        ::operator delete (header);
+    }
+}
+
+void ArenaObject::operator delete (void *p, StateArena *)
+{
+    operator delete (p);
+}
+
+size_t ArenaObject::allocation_size (size_t size)
+{
+    return align_up (sizeof (ArenaHeader) + size);
+}
+
+}
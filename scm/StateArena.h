@@ -0,0 +1,140 @@
+#ifndef StateArena_H
+#define StateArena_H
+
+#include "RefCountObject.h"
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace scm {
+
+/** StateArena
+ * 一個 machine 的 states 及其資料連續配置在此，不個別歸還，最後一個物件解構後整塊一起釋放。
+ * States of a machine and their data are allocated contiguously here. Nothing is returned one by one, the whole arena is freed after the last object in it is destructed.
+ */
+class StateArena: public RefCountObject
+{
+public:
+    explicit StateArena (size_t chunk_size);
+
+    void *allocate (size_t size);
+
+    /** \brief 已配置出去的 bytes。 Bytes handed out so far. */
+    size_t allocated_size () const {
+        return allocated_size_;
+    }
+
+protected:
+    virtual ~StateArena ();
+
+private:
+    std::vector<char *> chunks_;
+    char               *cur_;
+    size_t              left_;
+    size_t              chunk_size_;
+    size_t              allocated_size_;
+};
+
+/** ArenaObject
+ * 繼承此類別的物件可以用 new (arena) T(...) 配置在 StateArena 中，delete 照常使用。arena 為 0 時配置在 heap。
+ * 物件存在期間會 retain 所在的 arena。
+ * Objects derived from this can be allocated in a StateArena by new (arena) T(...), and deleted as usual. Allocated on heap if arena is 0.
+ * Each object retains its arena while alive.
+ */
+struct ArenaObject
+{
+    static void *operator new (size_t size);
+    static void *operator new (size_t size, StateArena *arena);
+    static void  operator delete (void *p);
+    static void  operator delete (void *p, StateArena *arena);
+
+    /** \brief 大小為 size 的物件在 arena 中實際佔用的 bytes。 Bytes an object of size takes in arena. */
+    static size_t allocation_size (size_t size);
+};
+
+/** ArenaAllocator
+ * 讓 std 容器配置在 StateArena 中，arena 為 0 時同 std::allocator。在 arena 中 deallocate 不做事。
+ * Lets std containers allocate from a StateArena, same as std::allocator if arena is 0. deallocate does nothing inside an arena.
+ */
+template <typename T> class ArenaAllocator
+{
+public:
+    typedef T              value_type;
+    typedef T             *pointer;
+    typedef T const       *const_pointer;
+    typedef T             &reference;
+    typedef T const       &const_reference;
+    typedef size_t         size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U> struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+
+    StateArena *arena_;
+
+    ArenaAllocator (StateArena *arena=0)
+        : arena_(arena)
+    {
+    }
+
+    template <typename U> ArenaAllocator (ArenaAllocator<U> const &rhs)
+        : arena_(rhs.arena_)
+    {
+    }
+
+    pointer allocate (size_type n, void const * =0)
+    {
+        if (arena_) {
+            return static_cast<pointer>(arena_->allocate (n * sizeof (T)));
+        }
+        return static_cast<pointer>(::operator new (n * sizeof (T)));
+    }
+
+    void deallocate (pointer p, size_type)
+    {
+        if (!arena_) {
+            ::operator delete (p);
+        }
+    }
+
+    void construct (pointer p, const_reference v)
+    {
+        new (static_cast<void *>(p)) T(v);
+    }
+
+    void destroy (pointer p)
+    {
+        p->~T();
+    }
+
+    size_type max_size () const
+    {
+        return size_type(-1) / sizeof (T);
+    }
+
+    pointer address (reference x) const
+    {
+        return &x;
+    }
+
+    const_pointer address (const_reference x) const
+    {
+        return &x;
+    }
+
+    template <typename U> bool operator== (ArenaAllocator<U> const &rhs) const
+    {
+        return arena_ == rhs.arena_;
+    }
+
+    template <typename U> bool operator!= (ArenaAllocator<U> const &rhs) const
+    {
+        return arena_ != rhs.arena_;
+    }
+};
+
+}
+
+#endif
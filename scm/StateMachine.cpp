@@ -8,50 +8,103 @@ using namespace std;
 namespace scm {
 
 namespace {
-    struct StateTimedEventTypeCmpP
+    struct TimedEntry
     {
-        bool operator () (TimedEventType *lhs, TimedEventType *rhs) const
+        int             event_id_;
+        TimedEventType *cancel_; // only cancelable events are allocated
+        int             leaving_state_; // index of the state whose leaving_delay is due, -1 for an event
+    };
+
+    struct PostedEvent
+    {
+        PostedEvent *next_;
+        int          event_id_; // 0 if posted by name_, interned when drained
+        std::string  name_;
+    };
+
+    struct ReleaseIfEvent
+    {
+        bool operator () (TimedEntry const &e) const
         {
-            return lhs->time_ < rhs->time_;
+            if (e.leaving_state_ >= 0) return false;
+            if (e.cancel_) e.cancel_->release ();
+            return true;
         }
     };
+
+    // queued in place of an event id when a leaving_delay is due
+    inline int leaving_marker (int state_index)
+    {
+        return -1 - state_index;
+    }
 }
 
 
 struct StateMachine::PRIVATE
 {
     StateMachine                 *mach_;
-    std::list <TimedEventType *> timed_events_;
-    std::vector<std::string>     queued_events_;
+    TimerQueue<TimedEntry>       timed_events_;
+    std::vector<int>             queued_events_;
+    boost::atomic<PostedEvent *> inbox_; // posted from any thread, newest first
+    TimerService::handle         shared_timer_; // earliest timed event in manager's TimerService
+    double                       shared_deadline_;
+    RefCountObject              *shared_token_; // shared timer only runs while this is retained by machine too, 0 once dying
     
     PRIVATE(StateMachine *mach)
     : mach_(mach)
+    , inbox_(0)
+    , shared_timer_(0)
+    , shared_deadline_(0)
+    , shared_token_(new RefCountObject)
     {
     }
     
     ~PRIVATE ()
     {
+        drop_inbox ();
     }
 
+    void post (PostedEvent *e);
+    void drain_inbox ();
+    void drop_inbox ();
+
     void loadSCXMLString (std::string const&xmlstr);
 
+    double timer_now () const;
+    timer_handle add_timed_event (double time, int event_id, TimedEventType *cancel, int leaving_state=-1);
+    void   schedule_shared_timer ();
+    void   cancel_shared_timer ();
+    void   drop_shared_timer ();
+    void   on_shared_timer ();
+
 };
 
 StateMachine::StateMachine (StateMachineManager *manager)
     : super ("", 0, this)
     , manager_(manager)
+    , model_(0)
+    , arena_(0)
+    , handlers_(0)
+    , handler_(0)
+    , ready_(false)
+    , next_ready_(0)
+    , posted_(false)
+    , next_posted_(0)
+    , tick_tracked_(false)
+    , tick_index_(-1)
+    , wake_timer_(0)
+    , last_tick_(0)
     , slots_prepared_(false)
     , slots_connected_(false)
     , scxml_loaded_(false)
-    , engine_started_(false)
     , on_event_(false)
     , with_history_(false)
-    , current_enter_state_(0)
-    , frame_move_slots_(0)
-    , cond_slots_(0)
-    , action_slots_(0)
     , allow_nop_entry_exit_slot_(false)
     , do_exit_state_on_destroy_(false)
+    , engine_started_(false)
+    , config_version_(0)
+    , current_enter_state_(0)
+    , enter_depth_(0)
 {
     private_ = new PRIVATE(this);
     this->addState (this);
@@ -59,8 +112,11 @@ StateMachine::StateMachine (StateMachineManager *manager)
 
 StateMachine::~StateMachine ()
 {
+    // machines may outlive their manager, don't touch its TimerService from here on
+    private_->drop_shared_timer ();
     this->clearTimedEvents ();    
     destroy_machine (do_exit_state_on_destroy_);
+    if (posted_) manager_->unpost (this);
     delete private_;
 }
 
@@ -69,16 +125,56 @@ StateMachine* StateMachine::clone ()
     StateMachine *mach = new StateMachine (manager_);
     mach->autorelease ();
 
-    mach->state_id_ = this->state_id_;
     mach->scxml_id_ = this->scxml_id_;
     mach->scxml_loaded_ = this->scxml_loaded_;
-
     mach->machine_ = mach;
-    mach->clone_data (this);
+
+    if (model_) {
+        // share ids and structure of the compiled chart, only runtime data is built per instance
+        mach->state_id_ = this->state_id_;
+        mach->state_uid_ = this->state_uid_;
+        mach->state_index_ = this->state_index_;
+        mach->set_model (model_);
+        mach->arena_ = new StateArena (arena_size_hint (model_));
+        mach->handlers_ = handlers_;
+        if (handlers_) handlers_->retain ();
+        mach->clone_data (this);
+    }
 
     return mach;
 }
 
+void StateMachine::set_model (ChartModel *model)
+{
+    if (model) model->retain ();
+    if (model_) model_->release ();
+    model_ = model;
+
+    // slots set so far are kept by name
+    action_slots_.bind_names (model_ ? &model_->action_slot_names () : 0);
+    cond_slots_.bind_names (model_ ? &model_->cond_slot_names () : 0);
+    frame_move_slots_.bind_names (model_ ? &model_->frame_move_slot_names () : 0);
+    cond_polling_.assign (model_ ? model_->cond_slot_names ().size () : 0, 1);
+
+    state_list_.clear ();
+    active_set_.clear ();
+    if (!model_) return;
+
+    active_set_.resize (model_->num_of_states ());
+
+    // index the states already in the tree, instance states register themselves when cloned
+    state_list_.resize (model_->num_of_states (), (State *)0);
+    std::vector<State *> stack (1, this);
+    while (!stack.empty ()) {
+        State *st = stack.back ();
+        stack.pop_back ();
+        if (st->state_index_ >= 0 && st->state_index_ < (int)state_list_.size ()) {
+            state_list_[st->state_index_] = st;
+        }
+        stack.insert (stack.end (), st->substates_.begin (), st->substates_.end ());
+    }
+}
+
 bool StateMachine::is_unique_id(std::string const&state_id) const
 {
     return !manager_ || manager_->is_unique_id(scxml_id_, state_id);
@@ -107,11 +203,20 @@ std::vector<std::string> StateMachine::getCurrentStateUId() const
 
 State* StateMachine::getState(std::string const& state_uid) const
 {
+    if (model_) {
+        return getState (model_->state_index (state_uid));
+    }
     map<std::string, State*>::const_iterator it = states_map_.find(state_uid);
     if (it == states_map_.end()) return 0;
     return it->second;
 }
 
+State* StateMachine::getState(int state_index) const
+{
+    if (state_index < 0 || state_index >= (int)state_list_.size()) return 0;
+    return state_list_[state_index];
+}
+
 void StateMachine::addState (State *state)
 {
     assert (state && "add state error!");
@@ -129,9 +234,12 @@ void StateMachine::removeState (State *state)
 
 bool StateMachine::inState (std::string const &state_uid) const
 {
-    map<std::string, State*>::const_iterator it = states_map_.find(state_uid);
-    if (it == states_map_.end()) return false;
-    return it->second->active();
+    if (model_) {
+        int index = model_->state_index (state_uid);
+        return index >= 0 && active_set_.test (index);
+    }
+    State *st = getState (state_uid);
+    return st && st->active();
 }
 
 double StateMachine::elapsed_time_of_current_state() const
@@ -144,32 +252,166 @@ void StateMachine::onFrameMove (float t)
     if (!slots_connected_) return;
     State::onFrameMove (t);
     pumpTimedEvents();
-    while (!private_->queued_events_.empty()) {
+    do {
         pumpQueuedEvents ();
+    } while (!private_->queued_events_.empty());
+}
+
+void StateMachine::onResume ()
+{
+    super::onResume ();
+    // paused time doesn't count
+    if (tick_tracked_) {
+        last_tick_ = manager_->timerService ().now ();
+        manager_->wakeMach (this);
     }
 }
 
+double StateMachine::next_deadline () const
+{
+    if (!slots_connected_) return no_deadline ();
+    if (!private_->queued_events_.empty () || private_->inbox_.load ()) return 0;
+    double d = State::next_deadline ();
+    if (!private_->timed_events_.empty ()) {
+        d = std::min (d, std::max (0.0, private_->timed_events_.top_time () - private_->timer_now ()));
+    }
+    return d;
+}
+
 void StateMachine::pumpQueuedEvents ()
 {
+    private_->drain_inbox ();
     if (private_->queued_events_.empty ()) {
         return;
     }
 
-    std::vector<string> events;
+    std::vector<int> events;
     events.swap(private_->queued_events_);
     for (size_t i=0; i < events.size (); ++i) {
-        this->onEvent (events[i]);
+        if (events[i] < 0) {
+            State *st = this->getState (-1 - events[i]);
+            if (st) st->finish_leaving ();
+        } else {
+            this->onEvent (events[i]);
+        }
     }
 }
 
 void StateMachine::enqueEvent(string const&e)
 {
-    private_->queued_events_.push_back (e);
+    enqueEvent (manager_->event_id (e));
+}
+
+void StateMachine::enqueEvent(int event_id)
+{
+    if (manager_->defer_event (this, event_id)) return;
+    private_->queued_events_.push_back (event_id);
+    manager_->addToActiveMach (this);
+}
+
+void StateMachine::enqueEvent(char const *e, size_t len)
+{
+    enqueEvent (manager_->event_id (e, len));
+}
+
+void StateMachine::enqueEvents(int const *event_ids, size_t n)
+{
+    if (n == 0) return;
+    if (manager_->defer_event (this, event_ids[0])) {
+        for (size_t i=1; i < n; ++i) {
+            postEvent (event_ids[i]);
+        }
+        return;
+    }
+    queue_events (event_ids, n);
+    manager_->addToActiveMach (this);
+}
+
+void StateMachine::enqueEvents(string const *events, size_t n)
+{
+    if (n == 0) return;
+    if (manager_->defer_event (this, manager_->event_id (events[0]))) {
+        for (size_t i=1; i < n; ++i) {
+            postEvent (manager_->event_id (events[i]));
+        }
+        return;
+    }
+    std::vector<int> &q = private_->queued_events_;
+    q.reserve (q.size () + n);
+    for (size_t i=0; i < n; ++i) {
+        q.push_back (manager_->event_id (events[i]));
+    }
     manager_->addToActiveMach (this);
 }
 
+void StateMachine::queue_events(int const *event_ids, size_t n)
+{
+    private_->queued_events_.insert (private_->queued_events_.end (), event_ids, event_ids + n);
+}
+
+void StateMachine::postEvent(string const&e)
+{
+    PostedEvent *p = new PostedEvent;
+    p->event_id_ = 0;
+    p->name_ = e;
+    private_->post (p);
+}
+
+void StateMachine::postEvent(int event_id)
+{
+    PostedEvent *p = new PostedEvent;
+    p->event_id_ = event_id;
+    private_->post (p);
+}
+
+void StateMachine::PRIVATE::post (PostedEvent *e)
+{
+    // expected is a local, boost writes it back even on success when e may already be drained
+    PostedEvent *head = inbox_.load ();
+    do {
+        e->next_ = head;
+    } while (!inbox_.compare_exchange_weak (head, e));
+    // the event is in before the flag is checked, whoever clears the flag drains it afterwards
+    if (!mach_->posted_.exchange (true)) {
+        mach_->manager_->post_ready (mach_);
+    }
+}
+
+void StateMachine::PRIVATE::drain_inbox ()
+{
+    if (!inbox_.load ()) return;
+    PostedEvent *e = inbox_.exchange (0);
+    PostedEvent *oldest = 0;
+    while (e) {
+        PostedEvent *next = e->next_;
+        e->next_ = oldest;
+        oldest = e;
+        e = next;
+    }
+    while (oldest) {
+        PostedEvent *next = oldest->next_;
+        queued_events_.push_back (oldest->event_id_ ? oldest->event_id_ : mach_->manager_->event_id (oldest->name_));
+        delete oldest;
+        oldest = next;
+    }
+}
+
+void StateMachine::PRIVATE::drop_inbox ()
+{
+    PostedEvent *e = inbox_.exchange (0);
+    while (e) {
+        PostedEvent *next = e->next_;
+        delete e;
+        e = next;
+    }
+}
 
-void StateMachine::onEvent(string const&e)
+int StateMachine::event_id(string const&e) const
+{
+    return manager_->event_id (e);
+}
+
+void StateMachine::onEvent(int e)
 {
     if (!this->slots_connected_) {
         assert (0 && " slots not connected");
@@ -204,6 +446,9 @@ void StateMachine::StartEngine ()
     prepareEngine ();
     engine_started_ = true;
     this->enterState ();
+    if (manager_->tickless ()) {
+        manager_->wakeMach (this);
+    }
 }
 
 void StateMachine::ReStartEngine ()
@@ -225,6 +470,56 @@ void StateMachine::ShutDownEngine (bool do_exit_state)
 {
     if (do_exit_state) this->exitState();
     engine_started_ = false;
+    stop_ticking ();
+}
+
+void StateMachine::ResetEngine (bool keep_slots)
+{
+    this->clearTimedEvents ();
+    private_->queued_events_.clear ();
+    private_->drop_inbox ();
+    stop_ticking ();
+
+    for (size_t i=0; i < state_list_.size (); ++i) {
+        if (state_list_[i]) state_list_[i]->reset_runtime ();
+    }
+    active_set_.reset ();
+
+    engine_started_ = false;
+    on_event_ = false;
+    pause_ = false;
+    current_enter_state_ = 0;
+    leaf_states_.clear ();
+    transition_source_state_.clear ();
+    transition_target_state_.clear ();
+
+    if (keep_slots) return;
+
+    for (size_t i=0; i < state_list_.size (); ++i) {
+        if (state_list_[i]) state_list_[i]->disconnect_slots ();
+    }
+
+    action_slots_.clear ();
+    cond_slots_.clear ();
+    frame_move_slots_.clear ();
+    cond_polling_.assign (cond_polling_.size (), 1);
+    handler_ = 0;
+
+    // structure prepared by prepare_slots () stays, only the clear history actions need registering again
+    if (slots_prepared_) {
+        for (size_t i=0; i < state_list_.size (); ++i) {
+            if (state_list_[i]) state_list_[i]->register_history_slots ();
+        }
+    }
+    slots_prepared_ = false;
+    slots_connected_ = false;
+
+    signal_prepare_slots_.disconnect_all_slots ();
+    signal_connect_cond_slots_.disconnect_all_slots ();
+    signal_connect_action_slots_.disconnect_all_slots ();
+    signal_on_frame_move_.disconnect_all_slots ();
+    signal_on_pause_.disconnect_all_slots ();
+    signal_on_resume_.disconnect_all_slots ();
 }
 
 bool StateMachine::engineReady () const
@@ -267,17 +562,12 @@ void StateMachine::clear_slots ()
 {
     slots_connected_ = false;
 
-    if (action_slots_) {
-        this->action_slots_->clear ();
-    }
-
-    if (cond_slots_) this->cond_slots_->clear ();
-
-    if (frame_move_slots_) {
-        this->frame_move_slots_->clear ();
-    }
+    this->action_slots_.clear ();
+    this->cond_slots_.clear ();
+    this->frame_move_slots_.clear ();
 
     this->transitions_.clear ();
+    this->transition_index_ = 0;
 }
 
 void StateMachine::destroy_machine (bool do_exit_state)
@@ -287,19 +577,26 @@ void StateMachine::destroy_machine (bool do_exit_state)
         scxml_loaded_ = false;
     }
     private_->queued_events_.clear ();
+    private_->drop_inbox ();
     states_map_.clear();
+    state_list_.clear();
     machine_clear_substates ();
     clear_slots ();
     reset_history ();
+    own_state_ids ();
+    set_model (0);
+    if (arena_) {
+        arena_->release ();
+        arena_ = 0;
+    }
+    if (handlers_) {
+        handlers_->release ();
+        handlers_ = 0;
+    }
+    handler_ = 0;
+    stop_ticking ();
 
 // clean machine
-    delete frame_move_slots_;
-    delete cond_slots_;
-    delete action_slots_;
-
-    frame_move_slots_ = 0;
-    cond_slots_ = 0;
-    action_slots_ = 0;
 
     engine_started_ = false;
 }
@@ -315,107 +612,254 @@ void StateMachine::PRIVATE::loadSCXMLString (std::string const&xmlstr)
 }
 
 
-bool StateMachine::GetCondSlot (string const&name, boost::function<bool ()> &s)
+bool StateMachine::find_action_slot (int slot, action_slot &s) const
 {
-    if (!cond_slots_) return false;
-
-    StateMachine::cond_slot_map::iterator it = this->cond_slots_->find (name);
-    if (it != this->cond_slots_->end ()) {
-        s = it->second;
+    if (action_slot const *p = action_slots_.find (slot)) {
+        s = *p;
+        return true;
+    }
+    HandlerTable::action_fn fn = handler_ ? handlers_->action (slot) : 0;
+    if (fn) {
+        s = BoundHandler0<void> (fn, handler_);
         return true;
     }
-
     return false;
 }
 
-
-bool StateMachine::GetActionSlot (string const&name, boost::function<void ()> &s)
+bool StateMachine::find_cond_slot (int slot, cond_slot &s) const
 {
-    if (!action_slots_) return false;
-
-    StateMachine::action_slot_map::iterator it = this->action_slots_->find (name);
-    if (it != this->action_slots_->end ()) {
-        s = it->second;
+    if (cond_slot const *p = cond_slots_.find (slot)) {
+        s = *p;
+        return true;
+    }
+    HandlerTable::cond_fn fn = handler_ ? handlers_->cond (slot) : 0;
+    if (fn) {
+        s = BoundHandler0<bool> (fn, handler_);
         return true;
     }
-
     return false;
 }
 
-bool StateMachine::GetFrameMoveSlot (std::string const&name, boost::function<void (float)> &s)
+bool StateMachine::find_frame_move_slot (int slot, frame_move_slot &s) const
 {
-    if (!frame_move_slots_) return false;
-
-    StateMachine::frame_move_map::iterator it = this->frame_move_slots_->find (name);
-    if (it != this->frame_move_slots_->end ()) {
-        s = it->second;
+    if (frame_move_slot const *p = frame_move_slots_.find (slot)) {
+        s = *p;
+        return true;
+    }
+    HandlerTable::frame_move_fn fn = handler_ ? handlers_->frame_move (slot) : 0;
+    if (fn) {
+        s = BoundHandler1<void, float> (fn, handler_);
         return true;
     }
-
     return false;
 }
 
-void StateMachine::setCondSlot (std::string const&name, boost::function<bool ()> const &s)
+void StateMachine::stop_ticking ()
 {
-    if (!cond_slots_) {
-        cond_slots_ = new cond_slot_map;
+    if (wake_timer_ || tick_index_ >= 0) manager_->sleepMach (this);
+    tick_tracked_ = false;
+}
+
+void StateMachine::attach_handler (void *handler, std::type_info const &type)
+{
+    if (!handlers_ && model_) {
+        handlers_ = manager_->handlerTable (scxml_id_);
+        if (handlers_) handlers_->retain ();
     }
+    assert (handlers_ && "no HandlerTable for this machine");
+    assert ((!handlers_ || !handlers_->handler_type () || *handlers_->handler_type () == type) && "handler is not of the class registered in HandlerTable");
+    if (!handlers_) return;
+    handler_ = handler;
+}
+
+void StateMachine::setCondPolling (string const&cond, bool polling)
+{
+    int slot = model_ ? model_->cond_slot_names ().find (cond) : -1;
+    if (slot < 0) return;
 
-    (*cond_slots_)[name] = s;
+    cond_polling_[slot] = polling;
+    std::vector<int> const &users = model_->no_event_cond_states (slot);
+    for (size_t i=0; i < users.size (); ++i) {
+        State *st = getState (users[i]);
+        if (st) {
+            st->update_no_event_polling ();
+            st->invalidate_no_events ();
+        }
+    }
 }
 
-void StateMachine::setActionSlot (std::string const&name, boost::function<void ()> const &s)
+void StateMachine::invalidateCond (string const&cond)
 {
-    if (!action_slots_) {
-        action_slots_ = new action_slot_map;
+    int slot = model_ ? model_->cond_slot_names ().find (cond) : -1;
+    if (slot < 0) return;
+
+    std::vector<int> const &users = model_->no_event_cond_states (slot);
+    for (size_t i=0; i < users.size (); ++i) {
+        State *st = getState (users[i]);
+        if (st) st->invalidate_no_events ();
     }
+    if (tick_tracked_) manager_->wakeMach (this);
+}
+
+bool StateMachine::GetCondSlot (string const&name, cond_slot &s)
+{
+    return cond_slots_.get (name, s);
+}
+
 
-    (*action_slots_)[name] = s;
+bool StateMachine::GetActionSlot (string const&name, action_slot &s)
+{
+    return action_slots_.get (name, s);
 }
 
-void StateMachine::setFrameMoveSlot (std::string const&name, boost::function<void (float)> const &s)
+bool StateMachine::GetFrameMoveSlot (std::string const&name, frame_move_slot &s)
 {
-    if (!frame_move_slots_) {
-        frame_move_slots_ = new frame_move_map;
-    }
+    return frame_move_slots_.get (name, s);
+}
 
-    (*frame_move_slots_)[name] = s;
+void StateMachine::setCondSlot (std::string const&name, cond_slot const &s)
+{
+    cond_slots_.set (name, s);
 }
 
-TimedEventType * StateMachine::registerTimedEvent (float after_t, string const&event_e, bool cancelable)
+void StateMachine::setActionSlot (std::string const&name, action_slot const &s)
 {
-    TimedEventType * p = new TimedEventType(after_t + total_elapsed_time_, event_e, cancelable);
-    list <TimedEventType *>::iterator it = std::upper_bound (private_->timed_events_.begin (), private_->timed_events_.end (), p, StateTimedEventTypeCmpP());
-    private_->timed_events_.insert (it, p);
+    action_slots_.set (name, s);
+}
+
+void StateMachine::setFrameMoveSlot (std::string const&name, frame_move_slot const &s)
+{
+    frame_move_slots_.set (name, s);
+}
+
+TimedEventType * StateMachine::registerTimedEvent (float after_t, int event_id, bool cancelable)
+{
+    double time = after_t + private_->timer_now ();
+    TimedEventType *p = 0;
+    if (cancelable) {
+        p = new TimedEventType(time, event_id, cancelable);
+    }
+    private_->add_timed_event (time, event_id, p);
     return p;
 }
 
+timer_handle StateMachine::scheduleTimedEvent (float after_t, int event_id)
+{
+    return private_->add_timed_event (after_t + private_->timer_now (), event_id, 0);
+}
+
+bool StateMachine::cancelTimedEvent (timer_handle h)
+{
+    TimedEntry entry;
+    if (!private_->timed_events_.cancel (h, &entry)) return false;
+    if (entry.cancel_) entry.cancel_->release ();
+    if (private_->timed_events_.empty ()) private_->cancel_shared_timer ();
+    return true;
+}
+
 void StateMachine::clearTimedEvents ()
 {
-    list <TimedEventType *>::iterator it = private_->timed_events_.begin ();
-    list <TimedEventType *>::iterator it_end = private_->timed_events_.end ();
-    for (; it != it_end ; ++it) {
-        (*it)->release ();
+    // leaving_delay timers belong to states, they are cancelled by State::stop_leaving ()
+    TimerQueue<TimedEntry> &q = private_->timed_events_;
+    q.remove_if (ReleaseIfEvent ());
+    if (q.empty ()) {
+        q.clear ();
+        private_->cancel_shared_timer ();
     }
-    private_->timed_events_.clear ();
+}
+
+double StateMachine::timer_now () const
+{
+    return private_->timer_now ();
+}
+
+timer_handle StateMachine::schedule_leaving (int state_index, double time)
+{
+    return private_->add_timed_event (time, 0, 0, state_index);
 }
 
 void StateMachine::pumpTimedEvents ()
 {
-    if (!private_->timed_events_.empty ()) {
-        list <TimedEventType *>::iterator it = private_->timed_events_.begin ();
-        for (; it != private_->timed_events_.end () ;) {
-            if ((*it)->time_ <= this->total_elapsed_time_) {
-                if (!(*it)->cancelable_ || !(*it)->unique_ref ()) {
-                    machine_->enqueEvent ((*it)->event_);
-                }
-                (*it)->release ();
-                private_->timed_events_.erase (it++);
-            } else {
-                break;
+    TimerQueue<TimedEntry> &q = private_->timed_events_;
+    double now = private_->timer_now ();
+    while (!q.empty () && q.top_time () <= now) {
+        TimedEntry entry = q.top ();
+        q.pop ();
+        if (entry.leaving_state_ >= 0) {
+            State *st = this->getState (entry.leaving_state_);
+            if (st) {
+                st->leaving_timer_fired ();
+                machine_->enqueEvent (leaving_marker (entry.leaving_state_));
+            }
+        } else if (!entry.cancel_) {
+            machine_->enqueEvent (entry.event_id_);
+        } else {
+            if (!entry.cancel_->unique_ref ()) {
+                machine_->enqueEvent (entry.event_id_);
             }
+            entry.cancel_->release ();
         }
     }
+    if (manager_->sharedTimers ()) {
+        private_->schedule_shared_timer ();
+    }
+}
+
+double StateMachine::PRIVATE::timer_now () const
+{
+    StateMachineManager *manager = mach_->manager_;
+    return manager->sharedTimers () ? manager->timerService ().now () : mach_->total_elapsed_time_;
+}
+
+timer_handle StateMachine::PRIVATE::add_timed_event (double time, int event_id, TimedEventType *cancel, int leaving_state)
+{
+    TimedEntry entry = { event_id, cancel, leaving_state };
+    timer_handle h = timed_events_.push (time, entry);
+    if (mach_->manager_->sharedTimers ()) {
+        schedule_shared_timer ();
+    }
+    return h;
+}
+
+void StateMachine::PRIVATE::schedule_shared_timer ()
+{
+    if (timed_events_.empty ()) {
+        cancel_shared_timer ();
+        return;
+    }
+    double deadline = timed_events_.top_time ();
+    if (!shared_token_ || (shared_timer_ && shared_deadline_ <= deadline)) return;
+
+    cancel_shared_timer ();
+    shared_deadline_ = deadline;
+    MutexLock lock (mach_->manager_->pump_lock ());
+    shared_token_->retain ();
+    shared_timer_ = mach_->manager_->timerService ().schedule (deadline, make_slot (&PRIVATE::on_shared_timer, this), shared_token_, true);
+}
+
+void StateMachine::PRIVATE::cancel_shared_timer ()
+{
+    if (shared_timer_) {
+        MutexLock lock (mach_->manager_->pump_lock ());
+        mach_->manager_->timerService ().cancel (shared_timer_);
+        shared_timer_ = 0;
+    }
+}
+
+void StateMachine::PRIVATE::drop_shared_timer ()
+{
+    // a pending shared timer sees the token unique and is skipped, without asking the manager
+    shared_timer_ = 0;
+    if (shared_token_) {
+        shared_token_->release ();
+        shared_token_ = 0;
+    }
+}
+
+void StateMachine::PRIVATE::on_shared_timer ()
+{
+    shared_timer_ = 0;
+    mach_->pumpTimedEvents ();
 }
 
 std::string const& StateMachine::state_id_of_history(const string& history_id) const
@@ -455,6 +899,9 @@ std::vector< TransitionAttr* > StateMachine::transition_attr(std::string const&
 
 size_t StateMachine::num_of_states() const
 {
+    if (model_) {
+        return model_->num_of_states ();
+    }
     return this->states_map_.size();
 }
 
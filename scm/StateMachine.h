@@ -4,11 +4,15 @@
 #include "State.h"
 #include "Parallel.h"
 #include "RefCountObject.h"
+#include "SlotTable.h"
+#include "HandlerTable.h"
+#include "TimerQueue.h"
 
 #include <string>
 #include <map>
 #include <deque>
 #include <set>
+#include <boost/atomic.hpp>
 
 namespace scm {
 
@@ -17,11 +21,11 @@ class StateMachineManager;
 struct TimedEventType: public RefCountObject
 {
     double      time_;
-    std::string event_;
+    int         event_id_;
     bool        cancelable_;
 
-    TimedEventType (double time, std::string const&str, bool cancelable)
-        :time_(time), event_(str), cancelable_(cancelable)
+    TimedEventType (double time, int event_id, bool cancelable)
+        :time_(time), event_id_(event_id), cancelable_(cancelable)
     {}
 
     bool operator< (TimedEventType const&rhs) const
@@ -40,13 +44,26 @@ class StateMachine : public State
     typedef State super;
 
 protected:
-    typedef std::map<std::string, boost::function<void (float)> >  frame_move_map;
-    typedef std::map<std::string, boost::function<bool ()> >       cond_slot_map;
-    typedef std::map<std::string, boost::function<void ()> >       action_slot_map; // used for onentry, onexit, and ontransit, etc.
-
     std::string scxml_id_;
 
     StateMachineManager *manager_;
+    ChartModel          *model_;
+    StateArena          *arena_; // states of an instance machine live here
+    HandlerTable        *handlers_; // shared by machines of the same scxml_id
+    void                *handler_; // handler object of this machine for handlers_
+
+    // in StateMachineManager's list of machines with queued events
+    bool                 ready_;
+    StateMachine        *next_ready_;
+    // in StateMachineManager's lock-free list of machines with posted events
+    boost::atomic<bool>  posted_;
+    StateMachine        *next_posted_;
+
+    // scheduling by StateMachineManager in tickless mode
+    bool                 tick_tracked_;
+    int                  tick_index_; // index in manager's every tick list, -1 if not there
+    timer_handle         wake_timer_;
+    double               last_tick_; // manager time of last frame_move
     
     bool slots_prepared_;
     bool slots_connected_;
@@ -58,18 +75,25 @@ protected:
     bool do_exit_state_on_destroy_;
     
     bool engine_started_;
+
+    size_t config_version_; // bumped whenever a state is entered or exited
+    boost::dynamic_bitset<> active_set_; // active configuration by state index
+    std::vector<unsigned char> cond_polling_; // by cond slot, see setCondPolling ()
     
-    frame_move_map             *frame_move_slots_;
-    cond_slot_map              *cond_slots_;
-    action_slot_map            *action_slots_;
+    SlotTable<frame_move_slot> frame_move_slots_;
+    SlotTable<cond_slot>       cond_slots_;
+    SlotTable<action_slot>     action_slots_; // used for onentry, onexit, and ontransit, etc.
 
     std::string transition_source_state_;
     std::string transition_target_state_;
 
     std::map<std::string, State*> states_map_;
+    std::vector<State *>          state_list_; // indexed by ChartModel state index
 
     State *current_enter_state_;
     std::vector<State *> leaf_states_;
+    std::deque<std::vector<State *> > enter_paths_; // reused by State::changeState (), one for each nested transition
+    size_t                            enter_depth_;
 
     friend class State;
     friend class Parallel;
@@ -87,14 +111,33 @@ protected:
     virtual void onConnectActionSlots () {}
     virtual void onLoadScxmlFailed () {}
 
-    void onEvent(std::string const&e);
+    void onEvent(int e);
+
+    /** \brief 取得編號 slot 的 slot，machine 沒有設定時由 HandlerTable 取得。 Slot of index, from HandlerTable if not set on machine. */
+    bool find_action_slot (int slot, action_slot &s) const;
+    bool find_cond_slot (int slot, cond_slot &s) const;
+    bool find_frame_move_slot (int slot, frame_move_slot &s) const;
+
+    void attach_handler (void *handler, std::type_info const &type);
+    /** \brief 停止 tickless 排程，沒有排程時不碰 manager (可能已解構)。 Stop tickless scheduling, the manager (maybe gone already) isn't touched if not scheduled. */
+    void stop_ticking ();
+
+    bool cond_polled (int slot) const {
+        return cond_polling_[slot] != 0;
+    }
+
+    /** \brief timed events 所用的時間。 Time used by timed events. */
+    double timer_now () const;
+    /** \brief 在時間 time 結束 state 的 leaving_delay。 End leaving_delay of state at time. */
+    timer_handle schedule_leaving (int state_index, double time);
 
     virtual void onFrameMove (float t);
+    virtual void onResume ();
 
     StateMachine (StateMachineManager *manager);
     
-	/** \brief after t seconds, enqueEvent event_e. If cancelable is true, you must retain and release later the returned object.*/
-	TimedEventType * registerTimedEvent(float after_t, std::string const&event_e, bool cancelable);
+	/** \brief after t seconds, enqueEvent event_e. If cancelable is true, you must retain and release later the returned object, otherwise returns 0.*/
+	TimedEventType * registerTimedEvent(float after_t, int event_id, bool cancelable);
 
 public:
 
@@ -107,6 +150,10 @@ public:
     
     StateMachineManager *manager () { return manager_;}
 
+    /** \brief 編譯後的 scxml，scxml 未載入時為 0。 Compiled scxml, 0 if scxml not loaded. */
+    ChartModel const *model () const { return model_; }
+    void set_model (ChartModel *model);
+
     bool is_unique_id (std::string const&state_id) const;
     
     std::string const & scxml_id () const {
@@ -130,6 +177,8 @@ public:
     }
 
     State *getState (std::string const& state_uid) const;
+    /** \brief 以 ChartModel 中的 state index 取得 state。 State by its ChartModel index, valid after engine prepared. */
+    State *getState (int state_index) const;
     void addState (State *state);
     void removeState (State *state);
     virtual bool inState (std::string const&state_uid) const;
@@ -138,6 +187,24 @@ public:
     
     /** \brief 將 event e 加到 event queue 中等待處理. Add event_e to event queue.*/
     void enqueEvent(std::string const&e);
+    /** \brief 同上，以 event id 指定。 Same as above, by interned event id. @see event_id() */
+    void enqueEvent(int event_id);
+    /** \brief 同上，名稱為 e 起的 len 個字元，例如直接取自接收的 buffer。 Same as above, named by the len chars at e, such as straight from a receive buffer. */
+    void enqueEvent(char const *e, size_t len);
+    /** \brief 依序加入 n 個 events，machine 只登記一次。 Add n events in order, the machine is listed only once. */
+    void enqueEvents(int const *event_ids, size_t n);
+    void enqueEvents(std::string const *events, size_t n);
+    /** 可在任何 thread 呼叫的 enqueEvent()。event 放進 lock-free inbox，由處理此 machine 的 thread 在 pumpQueuedEvents() 時取出，
+     * 同一 thread 送出的 events 依序處理。其他 thread 仍可能送出時 machine 必須存在。event 名稱在 event_id() 的鎖內轉成 id，需以 SCM_USE_THREADS 編譯。
+     * enqueEvent() that may be called from any thread. Events go into a lock-free inbox, which the thread handling this machine drains in pumpQueuedEvents().
+     * Events posted by one thread keep their order. The machine must stay alive while other threads may post to it. Names are interned under the lock of event_id(),
+     * which needs SCM_USE_THREADS to build.
+     */
+    void postEvent(std::string const&e);
+    void postEvent(int event_id);
+
+    /** \brief 取得 event 名稱對應的 id，可先取得後重複使用。 Interned id of event name, look it up once and reuse it. */
+    int event_id (std::string const&e) const;
 
     void prepareEngine ();
 
@@ -148,6 +215,13 @@ public:
     /** \brief 停止 StateMachine， do_exit_state 指定是否呼叫 exitState()。 */
     virtual void ShutDownEngine (bool do_exit_state);
 
+    /** 不重新配置而把 machine 重置回 StartEngine() 之前的狀態：清除 history、timed events 及 queued events，不呼叫 exit slot。
+     * 預設一併清除所有已設定的 slots，之後需重新設定才能 StartEngine()；keep_slots 為 true 時保留。預設與 StateMachineManager::recycleMach() 相同。
+     * Reset machine to its condition before StartEngine() without reallocation: history, timed events and queued events are cleared, no exit slot is called.
+     * By default all slots set are dropped as well and must be set again before StartEngine(), keep_slots true keeps them. Defaults the same as StateMachineManager::recycleMach().
+     */
+    void ResetEngine (bool keep_slots=false);
+
     void set_do_exit_state_on_destroy (bool yes) {
         do_exit_state_on_destroy_ = yes;
     }
@@ -160,30 +234,57 @@ public:
      */
     bool isLeavingState () const;
 
+    /** 距離此 machine 下次需要處理還有幾秒：有 queued events 時為 0，否則為 timed events、leaving_delay 及 frame_move slots 中最早的。
+     * 不需要時為 no_deadline()。
+     * Seconds until this machine next needs attention: 0 if events are queued, otherwise the earliest of timed events, leaving_delay and frame_move slots.
+     * no_deadline() if never.
+     */
+    virtual double next_deadline () const;
+
     /** 把所有外部 event 做一次處理。
      * Handle all queued events.
      */
     void pumpQueuedEvents ();
 
-    bool GetCondSlot (std::string const&name, boost::function<bool ()> &s);
-    bool GetActionSlot (std::string const&name, boost::function<void()> &s);
-    bool GetFrameMoveSlot (std::string const&name, boost::function<void (float)> &s);
+    /** polling 為真 (預設) 時 eventless transition 的 cond 每個 frame 檢查。為假時只在 configuration 改變或 invalidateCond() 後檢查，
+     * 用於只在特定事件後才會改變的 cond。名稱不在 scxml 中時忽略。
+     * If polling is true (default), cond of eventless transitions is checked every frame. If false, only after a configuration change or invalidateCond(),
+     * for conds that only change after known events. Names not referenced by scxml are ignored.
+     */
+    void setCondPolling (std::string const&cond, bool polling);
+    /** \brief cond 的值可能已改變，下個 frame 重新檢查用到它的 eventless transitions。 Value of cond may have changed, recheck eventless transitions using it next frame. */
+    void invalidateCond (std::string const&cond);
+
+    bool GetCondSlot (std::string const&name, cond_slot &s);
+    bool GetActionSlot (std::string const&name, action_slot &s);
+    bool GetFrameMoveSlot (std::string const&name, frame_move_slot &s);
 
     /** 建立 name 與 slot s 的對應，以供scxml 中的 cond 條件使用。
      * Mapping name and condition slot. Used in Transition conditions.
      */
-    void setCondSlot (std::string const&name, boost::function<bool ()> const &s);
+    void setCondSlot (std::string const&name, cond_slot const &s);
     /** 建立 name 與 slot s 的對應，以供scxml 中各state的 onentry, onexit 使用。
      * Mapping name and action slot. Used in state's onentry, onexit, etc. 
      */
-    void setActionSlot (std::string const&name, boost::function<void ()> const &s);
+    void setActionSlot (std::string const&name, action_slot const &s);
     /** 建立 name 與 slot s 的對應，以供scxml 中各state的 frame_move 使用。
      * Mapping namd and frame_move slot. Used in state's frame_move.
      */
-    void setFrameMoveSlot (std::string const&name, boost::function<void (float)> const &s);
+    void setFrameMoveSlot (std::string const&name, frame_move_slot const &s);
 
     StateMachine* clone ();
 
+    /** 指定此 machine 的 handler 物件，machine 沒有自己設定的 slot 由 HandlerTable 中的 member functions 以此物件呼叫。需在 StartEngine() 前呼叫。
+     * handler 須與 HandlerTable 中註冊的 member functions 同一類別。
+     * Attach handler object of this machine, slots not set on machine are called on it by member functions in HandlerTable. Call before StartEngine().
+     * handler must be of the same class the member functions in HandlerTable were registered with.
+     * @see StateMachineManager::handlerTable()
+     */
+    template <typename C> void attachHandler (C *handler)
+    {
+        attach_handler (handler, typeid (C));
+    }
+
     inline bool allow_nop_entry_exit () const {
         return allow_nop_entry_exit_slot_;
     }
@@ -191,9 +292,21 @@ public:
         allow_nop_entry_exit_slot_ = yes;
     }
 
-	void registerTimedEvent(float after_t, std::string const&event_e) { registerTimedEvent(after_t, event_e, false); }
-	TimedEventType * registerTimedEvent_cancelable(float after_t, std::string const&event_e) { return registerTimedEvent(after_t, event_e, true); }
+	void registerTimedEvent(float after_t, std::string const&event_e) { registerTimedEvent(after_t, event_id(event_e), false); }
+	void registerTimedEvent(float after_t, int event_id) { registerTimedEvent(after_t, event_id, false); }
+	TimedEventType * registerTimedEvent_cancelable(float after_t, std::string const&event_e) { return registerTimedEvent(after_t, event_id(event_e), true); }
+	TimedEventType * registerTimedEvent_cancelable(float after_t, int event_id) { return registerTimedEvent(after_t, event_id, true); }
+    /** 在 after_t 秒後 enqueEvent event_e，傳回的 handle 可用 cancelTimedEvent() 立即取消，不需配置 TimedEventType。
+     * enqueEvent event_e after after_t seconds. The returned handle cancels it at once by cancelTimedEvent(), no TimedEventType is allocated.
+     */
+    timer_handle scheduleTimedEvent(float after_t, std::string const&event_e) { return scheduleTimedEvent(after_t, event_id(event_e)); }
+    timer_handle scheduleTimedEvent(float after_t, int event_id);
+    /** \brief 已送出、已取消或被 clearTimedEvents() 清除的 handle 傳回 false。 false if h was already sent, canceled or cleared by clearTimedEvents(). */
+    bool cancelTimedEvent(timer_handle h);
 	void clearTimedEvents ();
+    /** \brief 送出到期的 timed events。使用 StateMachineManager 共用計時器時由 StateMachineManager::pumpTimers() 呼叫。
+     * Enqueue due timed events. Called by StateMachineManager::pumpTimers() if timers are shared by StateMachineManager.
+     */
     void pumpTimedEvents ();
 
     std::string const& state_id_of_history (std::string const&history_id) const;
@@ -208,12 +321,15 @@ public:
     
 public:
     // signals
-    bs2::signal<void ()>          signal_prepare_slots_;
-    bs2::signal<void ()>          signal_connect_cond_slots_;
-    bs2::signal<void ()>          signal_connect_action_slots_;
+    Signal<void ()>               signal_prepare_slots_;
+    Signal<void ()>               signal_connect_cond_slots_;
+    Signal<void ()>               signal_connect_action_slots_;
     
 
 private:
+    /** \brief 加到 event queue 但不登記到 StateMachineManager。 Add to the event queue without listing in StateMachineManager. */
+    void queue_events (int const *event_ids, size_t n);
+
     struct PRIVATE;
     friend struct PRIVATE;
     PRIVATE *private_;
@@ -221,9 +337,9 @@ private:
 
 #define REGISTER_STATE_SLOT(mach, state, onentry, onexit, obj) \
     { \
-    boost::function<void ()> slot = boost::bind (onentry, obj); \
+    scm::action_slot slot = scm::make_slot (onentry, obj); \
     mach->setActionSlot ("onentry_" state, slot); \
-    slot = boost::bind (onexit, obj); \
+    slot = scm::make_slot (onexit, obj); \
     mach->setActionSlot ("onexit_" state, slot); \
     }
     
@@ -232,13 +348,13 @@ private:
     void onexit_##state ();
     
 #define REGISTER_ACTION_SLOT(mach, action, method, obj) \
-	mach->setActionSlot (action, boost::bind(method, obj));
+	mach->setActionSlot (action, scm::make_slot(method, obj));
 
 #define REGISTER_FRAME_MOVE_SLOT(mach, state, method, obj) \
-	mach->setFrameMoveSlot (state, boost::bind(method, obj, _1));
+	mach->setFrameMoveSlot (state, scm::make_slot(method, obj));
 
 #define REGISTER_COND_SLOT(mach, cond, method, obj) \
-	mach->setCondSlot (cond, boost::bind(method, obj));
+	mach->setCondSlot (cond, scm::make_slot(method, obj));
 
 
 }
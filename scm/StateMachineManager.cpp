@@ -2,9 +2,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <deque>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/property_tree/json_parser.hpp>
+#ifdef SCM_USE_THREADS
+#include <boost/thread/tss.hpp>
+#endif
 
 using boost::property_tree::ptree;
 using boost::property_tree::read_xml;
@@ -29,6 +36,23 @@ public:
 
 static StateMachineManager *static_instance_;
 
+// event names are looked up by string_ref too, without building a std::string
+struct EventNameHash
+{
+    size_t operator () (boost::string_ref s) const
+    {
+        return boost::hash_range (s.begin (), s.end ());
+    }
+};
+
+struct EventNameEqual
+{
+    bool operator () (boost::string_ref a, boost::string_ref b) const
+    {
+        return a == b;
+    }
+};
+
 template <typename T>
 class array_guard {
     T *ptr_;
@@ -135,10 +159,31 @@ namespace {
 struct StateMachineManager::PRIVATE
 {
     StateMachineManager     * manager_;
-    std::list<StateMachine *> active_machs_;
+    StateMachine            * ready_head_; // machines with queued events, linked by StateMachine::next_ready_, retained
+    StateMachine            * ready_tail_;
+    boost::atomic<StateMachine *> posted_head_; // machines with posted events, linked by StateMachine::next_posted_
+    TimerService              timers_;
+    bool                      shared_timers_;
+
+    // parallel pump
+    WorkerPool                   workers_;
+    bool                         parallel_; // a parallel round is running
+    Mutex                        lock_; // guards shared data from workers while parallel_
+    std::vector<StateMachine *>  round_; // machines of the running round
+#ifdef SCM_USE_THREADS
+    boost::thread_specific_ptr<StateMachine> pumping_; // machine pumped by this thread
+#else
+    StateMachine                *pumping_;
+#endif
+
+    // tickless mode
+    bool                         tickless_;
+    TimerQueue<StateMachine *>   wake_queue_; // machines waiting for their next deadline
+    std::vector<StateMachine *>  tick_machs_; // machines needing every tick
     
     // ids are unique
     map <string, StateMachine *>       mach_map_;
+    map <string, vector<StateMachine *> > mach_pool_; // recycled machines, retained
     map <string, map<string, string> > onentry_action_map_;
     map <string, map<string, string> > onexit_action_map_;
     map <string, map<string, string> > frame_move_action_map_;
@@ -150,10 +195,28 @@ struct StateMachineManager::PRIVATE
     map <string, map<string, vector<TransitionAttr *> > > transition_attr_map_;
 
     map<string, string> scxml_map_;
+
+    // event atom table, names may be interned from any thread by postEvent ()
+    boost::unordered_map<string, int, EventNameHash, EventNameEqual> event_ids_;
+    deque<string>                     event_names_; // references stay valid while names are added
+    mutable Mutex                     event_lock_; // always taken, does nothing without SCM_USE_THREADS
     
     PRIVATE(StateMachineManager *manager)
     : manager_(manager)
+    , ready_head_(0)
+    , ready_tail_(0)
+    , posted_head_(0)
+    , shared_timers_(false)
+    , parallel_(false)
+#ifdef SCM_USE_THREADS
+    , pumping_(&PRIVATE::keep_machine)
+#else
+    , pumping_(0)
+#endif
+    , tickless_(false)
     {
+        event_ids_[""] = 0;
+        event_names_.push_back("");
     }
     
     ~PRIVATE()
@@ -162,7 +225,25 @@ struct StateMachineManager::PRIVATE
     }
     
     StateMachine *getMach (string const&scxml_id);
+    StateMachine *prototype (string const&scxml_id);
     void          clearMachMap ();
+    void          clearMachPool ();
+
+    void          catch_up (StateMachine *mach);
+    void          unschedule (StateMachine *mach);
+    void          detach_machs ();
+
+    Mutex        *pump_lock () {
+        return parallel_ ? &lock_ : 0;
+    }
+    StateMachine *pumping () const;
+    void          set_pumping (StateMachine *mach);
+    void          add_ready (StateMachine *mach);
+    void          take_posted ();
+    void          push_posted (StateMachine *mach);
+    void          pump_parallel (StateMachine *ready);
+    void          pump_one (size_t index);
+    static void   keep_machine (StateMachine *) {}
 
     static void get_item_attrs_in_ptree(ptree& pt, map<string, string> &attrs_map);
     static void parse_element(ParseStruct &data, ptree &pt, int level);
@@ -420,6 +501,7 @@ void StateMachineManager::PRIVATE::handle_transition_item(ParseStruct& data, map
     for (; attr_it != attr_it_end; ++attr_it) {
         if (attr_it->first == "event") {
             tran->event_ = attr_it->second;
+            tran->event_id_ = manager->event_id (tran->event_);
         } else if (attr_it->first == "cond") {
             tran->cond_ = attr_it->second;
         } else if (attr_it->first == "ontransit") {
@@ -514,6 +596,10 @@ StateMachineManager::StateMachineManager()
 
 StateMachineManager::~StateMachineManager()
 {
+    if (PunctualFrameMover::timerService () == &private_->timers_) {
+        PunctualFrameMover::bindTimerService (0);
+    }
+    private_->detach_machs ();
     delete private_;
 }
 
@@ -538,29 +624,369 @@ StateMachine *StateMachineManager::getMach (string const&scxml_id)
     return private_->getMach(scxml_id);
 }
 
+StateMachine *StateMachineManager::acquireMach (string const&scxml_id)
+{
+    map <string, vector<StateMachine *> >::iterator it = private_->mach_pool_.find (scxml_id);
+    if (it == private_->mach_pool_.end () || it->second.empty ()) {
+        return private_->getMach (scxml_id);
+    }
+
+    StateMachine *mach = it->second.back ();
+    it->second.pop_back ();
+    mach->autorelease (); // pass the reference held by pool to caller
+    return mach;
+}
+
+void StateMachineManager::recycleMach (StateMachine *mach, bool keep_slots)
+{
+    assert (mach && mach->manager () == this);
+    if (!mach || mach->manager () != this) return;
+    if (!mach->engineReady ()) return; // nothing to reuse
+
+    mach->ResetEngine (keep_slots);
+    mach->retain ();
+    private_->mach_pool_[mach->scxml_id ()].push_back (mach);
+}
+
+void StateMachineManager::clearMachPool ()
+{
+    private_->clearMachPool ();
+}
+
+HandlerTable *StateMachineManager::handlerTable (string const&scxml_id)
+{
+    StateMachine *mach = private_->prototype (scxml_id);
+    if (!mach->model_) return 0;
+
+    if (!mach->handlers_) {
+        mach->handlers_ = new HandlerTable (mach->model_);
+    }
+    return mach->handlers_;
+}
+
 void StateMachineManager::addToActiveMach(StateMachine* mach)
 {
     assert (mach);
-    if (!mach) return;
+    MutexLock lock (private_->pump_lock ());
+    if (mach) private_->add_ready (mach);
+}
+
+void StateMachineManager::enqueEvent (StateMachine *const *machs, size_t n, int event_id)
+{
+    if (private_->parallel_) {
+        // enqueEvent () posts it to machines other than the pumped one
+        for (size_t i=0; i < n; ++i) {
+            machs[i]->enqueEvent (event_id);
+        }
+        return;
+    }
+    for (size_t i=0; i < n; ++i) {
+        machs[i]->queue_events (&event_id, 1);
+        private_->add_ready (machs[i]);
+    }
+}
+
+void StateMachineManager::PRIVATE::add_ready (StateMachine *mach)
+{
+    if (mach->ready_) return;
     mach->retain();
-    private_->active_machs_.push_back(mach);
+    mach->ready_ = true;
+    mach->next_ready_ = 0;
+    if (ready_tail_) {
+        ready_tail_->next_ready_ = mach;
+    } else {
+        ready_head_ = mach;
+    }
+    ready_tail_ = mach;
 }
 
 void StateMachineManager::pumpMachEvents()
 {
-    while (!private_->active_machs_.empty ()) {
-        std::list<StateMachine *> machs;
-        machs.swap (private_->active_machs_);
-        std::list<StateMachine *>::iterator it = machs.begin ();
-        std::list<StateMachine *>::iterator it_end = machs.end ();
-        for (; it != it_end; ++it) {
-            (*it)->pumpQueuedEvents ();
-            (*it)->release();
+    for (private_->take_posted (); private_->ready_head_; private_->take_posted ()) {
+        // machines getting events while pumped are listed again for the next round
+        StateMachine *mach = private_->ready_head_;
+        private_->ready_head_ = private_->ready_tail_ = 0;
+        if (private_->workers_.size () && mach->next_ready_) {
+            private_->pump_parallel (mach);
+            continue;
+        }
+        while (mach) {
+            StateMachine *next = mach->next_ready_;
+            mach->next_ready_ = 0;
+            mach->ready_ = false;
+            if (private_->tickless_) {
+                private_->catch_up (mach);
+                mach->pumpQueuedEvents ();
+                wakeMach (mach);
+            } else {
+                mach->pumpQueuedEvents ();
+            }
+            mach->release();
+            mach = next;
         }
     }
 
 }
 
+void StateMachineManager::PRIVATE::pump_parallel (StateMachine *ready)
+{
+    round_.clear ();
+    while (ready) {
+        StateMachine *next = ready->next_ready_;
+        ready->next_ready_ = 0;
+        ready->ready_ = false;
+        round_.push_back (ready);
+        ready = next;
+    }
+
+    parallel_ = true;
+    workers_.run (round_.size (), make_slot (&PRIVATE::pump_one, this));
+    parallel_ = false;
+
+    // back on the calling thread
+    for (size_t i=0; i < round_.size (); ++i) {
+        if (tickless_) manager_->wakeMach (round_[i]);
+        round_[i]->release ();
+    }
+    round_.clear ();
+}
+
+void StateMachineManager::PRIVATE::pump_one (size_t index)
+{
+    StateMachine *mach = round_[index];
+    set_pumping (mach);
+    if (tickless_) catch_up (mach);
+    mach->pumpQueuedEvents ();
+    set_pumping (0);
+}
+
+StateMachine *StateMachineManager::PRIVATE::pumping () const
+{
+#ifdef SCM_USE_THREADS
+    return pumping_.get ();
+#else
+    return pumping_;
+#endif
+}
+
+void StateMachineManager::PRIVATE::set_pumping (StateMachine *mach)
+{
+#ifdef SCM_USE_THREADS
+    pumping_.reset (mach);
+#else
+    pumping_ = mach;
+#endif
+}
+
+bool StateMachineManager::defer_event (StateMachine *mach, int event_id)
+{
+    if (!private_->parallel_ || private_->pumping () == mach) return false;
+    mach->postEvent (event_id);
+    return true;
+}
+
+void StateMachineManager::post_ready (StateMachine *mach)
+{
+    private_->push_posted (mach);
+}
+
+void StateMachineManager::unpost (StateMachine *mach)
+{
+    // only the thread pumping machines takes from the list, put back all but mach
+    StateMachine *posted = private_->posted_head_.exchange (0);
+    while (posted) {
+        StateMachine *next = posted->next_posted_;
+        if (posted != mach) private_->push_posted (posted);
+        posted = next;
+    }
+}
+
+void StateMachineManager::PRIVATE::push_posted (StateMachine *mach)
+{
+    // expected is a local, see StateMachine::PRIVATE::post ()
+    StateMachine *head = posted_head_.load ();
+    do {
+        mach->next_posted_ = head;
+    } while (!posted_head_.compare_exchange_weak (head, mach));
+}
+
+void StateMachineManager::PRIVATE::take_posted ()
+{
+    StateMachine *mach = posted_head_.exchange (0);
+    while (mach) {
+        StateMachine *next = mach->next_posted_;
+        // posts from now on list it again, its inbox is drained in pumpQueuedEvents ()
+        mach->posted_ = false;
+        manager_->addToActiveMach (mach);
+        mach = next;
+    }
+}
+
+Mutex *StateMachineManager::pump_lock ()
+{
+    return private_->pump_lock ();
+}
+
+void StateMachineManager::setWorkerThreads (size_t threads)
+{
+    private_->workers_.resize (threads);
+}
+
+size_t StateMachineManager::workerThreads () const
+{
+    return private_->workers_.size ();
+}
+
+void StateMachineManager::setSharedTimers (bool yes)
+{
+    private_->shared_timers_ = yes;
+}
+
+bool StateMachineManager::sharedTimers () const
+{
+    return private_->shared_timers_;
+}
+
+void StateMachineManager::pumpTimers (double t)
+{
+    private_->timers_.advance (t);
+}
+
+TimerService &StateMachineManager::timerService ()
+{
+    return private_->timers_;
+}
+
+void StateMachineManager::setTickless (bool yes)
+{
+    private_->tickless_ = yes;
+    if (yes) private_->shared_timers_ = true;
+}
+
+bool StateMachineManager::tickless () const
+{
+    return private_->tickless_;
+}
+
+void StateMachineManager::tick (double t)
+{
+    pumpTimers (t);
+    pumpMachEvents ();
+
+    double now = private_->timers_.now ();
+    vector<StateMachine *> due (private_->tick_machs_);
+    TimerQueue<StateMachine *> &wake_queue = private_->wake_queue_;
+    while (!wake_queue.empty () && wake_queue.top_time () <= now) {
+        StateMachine *mach = wake_queue.top ();
+        wake_queue.pop ();
+        mach->wake_timer_ = 0;
+        due.push_back (mach);
+    }
+
+    // a machine may release another one while moving
+    for (size_t i=0; i < due.size (); ++i) {
+        due[i]->retain ();
+    }
+    for (size_t i=0; i < due.size (); ++i) {
+        private_->catch_up (due[i]);
+        wakeMach (due[i]);
+    }
+    for (size_t i=0; i < due.size (); ++i) {
+        due[i]->release ();
+    }
+
+    pumpMachEvents ();
+}
+
+double StateMachineManager::next_deadline () const
+{
+    if (private_->ready_head_ || private_->posted_head_.load () || !private_->tick_machs_.empty ()) return 0;
+
+    double now = private_->timers_.now ();
+    double d = no_deadline ();
+    if (!private_->timers_.empty ()) {
+        d = std::min (d, private_->timers_.next_deadline () - now);
+    }
+    if (!private_->wake_queue_.empty ()) {
+        d = std::min (d, private_->wake_queue_.top_time () - now);
+    }
+    return std::max (d, 0.0);
+}
+
+void StateMachineManager::wakeMach (StateMachine *mach)
+{
+    if (!private_->tickless_ || !mach->engine_started_) return;
+    MutexLock lock (private_->pump_lock ());
+
+    double now = private_->timers_.now ();
+    if (!mach->tick_tracked_) {
+        mach->tick_tracked_ = true;
+        mach->last_tick_ = now;
+    }
+
+    double d = mach->next_deadline ();
+    if (d <= 0 && mach->tick_index_ >= 0) {
+        // stays in every tick list
+        if (mach->wake_timer_) private_->wake_queue_.cancel (mach->wake_timer_);
+        mach->wake_timer_ = 0;
+        return;
+    }
+
+    private_->unschedule (mach);
+    if (d <= 0) {
+        mach->tick_index_ = (int)private_->tick_machs_.size ();
+        private_->tick_machs_.push_back (mach);
+    } else if (d != no_deadline ()) {
+        mach->wake_timer_ = private_->wake_queue_.push (now + d, mach);
+    }
+}
+
+void StateMachineManager::sleepMach (StateMachine *mach)
+{
+    MutexLock lock (private_->pump_lock ());
+    private_->unschedule (mach);
+    mach->tick_tracked_ = false;
+}
+
+void StateMachineManager::PRIVATE::catch_up (StateMachine *mach)
+{
+    if (!mach->tick_tracked_) return;
+    double now = timers_.now ();
+    double dt = now - mach->last_tick_;
+    mach->last_tick_ = now;
+    if (dt > 0) mach->frame_move ((float)dt);
+}
+
+void StateMachineManager::PRIVATE::detach_machs ()
+{
+    // machines may outlive the manager, they must not find themselves in its lists afterwards
+    for (; !wake_queue_.empty (); wake_queue_.pop ()) {
+        wake_queue_.top ()->wake_timer_ = 0;
+    }
+    for (size_t i=0; i < tick_machs_.size (); ++i) {
+        tick_machs_[i]->tick_index_ = -1;
+    }
+    tick_machs_.clear ();
+    for (StateMachine *mach = posted_head_.exchange (0); mach; mach = mach->next_posted_) {
+        mach->posted_ = false;
+    }
+}
+
+void StateMachineManager::PRIVATE::unschedule (StateMachine *mach)
+{
+    if (mach->wake_timer_) {
+        wake_queue_.cancel (mach->wake_timer_);
+        mach->wake_timer_ = 0;
+    }
+    if (mach->tick_index_ >= 0) {
+        StateMachine *last = tick_machs_.back ();
+        tick_machs_[mach->tick_index_] = last;
+        last->tick_index_ = mach->tick_index_;
+        tick_machs_.pop_back ();
+        mach->tick_index_ = -1;
+    }
+}
+
 void StateMachineManager::set_scxml(const string& scxml_id, const string& scxml_str)
 {
     private_->scxml_map_[scxml_id] = scxml_str;
@@ -631,15 +1057,27 @@ bool StateMachineManager::loadMachFromString(StateMachine* mach, const string& s
     parse.current_state_ = mach;
     private_->transition_attr_map_[parse.scxml_id_].clear();
 
-    return private_->parse_scm_tree(parse, scm_str);
+    if (!private_->parse_scm_tree(parse, scm_str)) {
+        return false;
+    }
+
+    ChartModel *model = new ChartModel (this, mach);
+    mach->set_model (model);
+    model->release ();
+    return true;
 }
 
 
 StateMachine* StateMachineManager::PRIVATE::getMach(const string& scxml_id)
+{
+    return prototype (scxml_id)->clone ();
+}
+
+StateMachine* StateMachineManager::PRIVATE::prototype(const string& scxml_id)
 {
     map<string, StateMachine *>::iterator it = mach_map_.find (scxml_id);
     if (it != mach_map_.end ()) {
-        return it->second->clone ();
+        return it->second;
     } else {
         StateMachine *mach = new StateMachine (manager_);
         mach_map_[scxml_id] = mach;
@@ -652,12 +1090,23 @@ StateMachine* StateMachineManager::PRIVATE::getMach(const string& scxml_id)
                 mach->scxml_loaded_ = manager_->loadMachFromString(mach, it->second);
             }
         }
-        return mach->clone ();
+        return mach;
     }
 }
 
+void StateMachineManager::PRIVATE::clearMachPool ()
+{
+    for (map <string, vector<StateMachine *> >::iterator it=mach_pool_.begin (); it != mach_pool_.end (); ++it) {
+        for (size_t i=0; i < it->second.size (); ++i) {
+            it->second[i]->release ();
+        }
+    }
+    mach_pool_.clear ();
+}
+
 void StateMachineManager::PRIVATE::clearMachMap ()
 {
+    clearMachPool ();
     for (map <string, StateMachine *>::iterator it=mach_map_.begin (); it != mach_map_.end (); ++it) {
         it->second->release ();
     }
@@ -733,4 +1182,36 @@ const vector< string > & StateMachineManager::get_all_states(const string& scxml
 }
 
 
+int StateMachineManager::event_id(const string& event)
+{
+    return event_id (event.data (), event.size ());
+}
+
+int StateMachineManager::event_id(char const *event, size_t len)
+{
+    boost::string_ref name (event, len);
+    MutexLock lock (&private_->event_lock_);
+    boost::unordered_map<string, int, EventNameHash, EventNameEqual>::iterator it = private_->event_ids_.find(name, EventNameHash (), EventNameEqual ());
+    if (it != private_->event_ids_.end()) {
+        return it->second;
+    }
+    int id = (int)private_->event_names_.size();
+    private_->event_names_.push_back(string (event, len));
+    private_->event_ids_[private_->event_names_.back ()] = id;
+    return id;
+}
+
+const string& StateMachineManager::event_name(int event_id) const
+{
+    MutexLock lock (&private_->event_lock_);
+    assert (event_id >= 0 && event_id < (int)private_->event_names_.size() && "invalid event id");
+    return private_->event_names_[event_id];
+}
+
+size_t StateMachineManager::num_of_events() const
+{
+    MutexLock lock (&private_->event_lock_);
+    return private_->event_names_.size();
+}
+
 }
@@ -2,7 +2,9 @@
 #define StateMachineManager_H
 
 #include "StateMachine.h"
+#include "TimerService.h"
 #include "uncopyable.h"
+#include "WorkerPool.h"
 
 namespace scm {
 
@@ -16,6 +18,21 @@ public:
     ~StateMachineManager();
     
     StateMachine *getMach (std::string const&scxml_id);
+
+    /** 從 pool 取出之前回收的 machine，pool 中沒有時同 getMach()。傳回的 machine 一樣是 autorelease 的。
+     * Take a recycled machine out of pool, same as getMach() if none left. The returned machine is autoreleased as well.
+     */
+    StateMachine *acquireMach (std::string const&scxml_id);
+    /** 不再使用的 machine 以 StateMachine::ResetEngine(keep_slots) 重置後放入 pool，之後由 acquireMach() 取出重複使用。預設不保留 slots，以免呼叫到舊的物件。
+     * Reset a machine no longer used by StateMachine::ResetEngine(keep_slots) and keep it in pool, acquireMach() hands it out again. Slots aren't kept by default, so stale objects are never called.
+     */
+    void recycleMach (StateMachine *mach, bool keep_slots=false);
+    void clearMachPool ();
+
+    /** 取得 scxml_id 共用的 HandlerTable，第一次呼叫時建立，scxml 無法載入時傳回 0。
+     * HandlerTable shared by machines of scxml_id, created at first call, 0 if scxml can't be loaded.
+     */
+    HandlerTable *handlerTable (std::string const&scxml_id);
     
     void set_scxml (std::string const&scxml_id, std::string const&scxml_str);
     void set_scxml_file (std::string const&scxml_id, std::string const&scxml_filepath);
@@ -34,14 +51,79 @@ public:
     size_t             num_of_states (const std::string& scxml_id) const;
     bool is_unique_id (const std::string& scxml_id, std::string const&state_uid) const;
     const std::vector<std::string> & get_all_states (const std::string& scxml_id) const;
+
+    /** 將 event 名稱轉成整數 id，同名 event 永遠得到同一個 id。id 0 保留給無 event 的 transition。以 SCM_USE_THREADS 編譯時可在任何 thread 呼叫。
+     * Intern event name and return its id, the same name always maps to the same id. Id 0 is reserved for eventless transitions. May be called from any thread if built with SCM_USE_THREADS.
+     */
+    int event_id (std::string const&event);
+    /** \brief 同上，名稱為 event 起的 len 個字元，已登記的名稱不需建立 std::string。 Same as above for the len chars at event, no std::string is built for known names. */
+    int event_id (char const *event, size_t len);
+    std::string const& event_name (int event_id) const;
+    size_t num_of_events () const;
     
     void addToActiveMach(StateMachine* mach);
+    /** \brief 把同一個 event 加到 n 個 machines 的 event queue。 Add the same event to the event queues of n machines. @see StateMachine::enqueEvent() */
+    void enqueEvent (StateMachine *const *machs, size_t n, int event_id);
     void pumpMachEvents ();
+
+    /** 設定 pumpMachEvents() 所用的 worker threads 數，0 (預設) 時在呼叫的 thread 上處理。需以 SCM_USE_THREADS 編譯，否則永遠為 0。
+     * 有 worker 時每一輪的 machines 分給各 worker 及呼叫的 thread，一個 machine 的 events 及 slots 都在同一 thread 上執行，整輪完成才進行下一輪。
+     * 此時 slots 只能改變自己的 machine：送給其他 machine 的 events 在該輪結束後才送達，不可 autorelease、建立或釋放 machine，也不可使用 PunctualFrameMover 的 timed actions。
+     * Number of worker threads pumpMachEvents() uses, 0 (default) pumps on the calling thread. Needs SCM_USE_THREADS to build, always 0 otherwise.
+     * With workers, machines of each round are shared out between the workers and the calling thread, events and slots of a machine all run on one thread, and a round ends when all are done.
+     * Slots may then only change their own machine: events enqueued to other machines are delivered after the round, and autorelease, creating or releasing machines, or timed actions of PunctualFrameMover are not allowed.
+     */
+    void   setWorkerThreads (size_t threads);
+    size_t workerThreads () const;
+
+    /** 為真時所有 machine 的 timed events 以 StateMachineManager 的時間計時，由 pumpTimers() 送出，machine 不需為此 frame_move()，也不受 pause 影響。
+     * 預設為假，timed events 以各 machine 的 frame_move() 時間計時。需在登記任何 timed event 前設定。
+     * If true, timed events of every machine are timed by StateMachineManager and sent by pumpTimers(), machines needn't frame_move() for them and pause doesn't stop them.
+     * False by default, timed events are timed by frame_move() of each machine. Set before any timed event is registered.
+     */
+    void setSharedTimers (bool yes);
+    bool sharedTimers () const;
+
+    /** 時間前進 t 秒，到期的 timed events 送到所屬 machine，並執行以 PunctualFrameMover::bindTimerService() 綁定此 manager 時的 timed actions。之後呼叫 pumpMachEvents() 處理送出的 events。
+     * 這是 timerService() 唯一推進時間的地方，tickless mode 中由 tick() 呼叫，不可再另外呼叫。
+     * Move time forward t seconds, enqueue due timed events into their machines and run timed actions of PunctualFrameMover if bound to this manager by PunctualFrameMover::bindTimerService().
+     * Call pumpMachEvents() afterwards to handle the events. This is the only place time of timerService() moves, tick() calls it in tickless mode so don't call it as well.
+     */
+    void pumpTimers (double t);
+    TimerService &timerService ();
+
+    /** 為真時 (tickless mode) 以 tick() 取代對每個 machine 呼叫 frame_move()：只有需要的 machine 才會被 frame_move()，
+     * 時間則一次補足。同時使用共用計時器，見 setSharedTimers()。需在任何 machine StartEngine() 前設定。
+     * If true (tickless mode), tick() replaces calling frame_move() on every machine: only machines with due work are frame_move()d,
+     * with all the time elapsed since their last frame_move(). Timers are shared as well, see setSharedTimers(). Set before any machine StartEngine().
+     */
+    void setTickless (bool yes);
+    bool tickless () const;
+    /** \brief tickless mode 中時間前進 t 秒：送出到期的 timed events，處理 events，並 frame_move() 有到期工作的 machines。
+     * Move time forward t seconds in tickless mode: send due timed events, handle events, and frame_move() machines with due work.
+     */
+    void tick (double t);
+    /** \brief 距離 tick() 下次有工作還有幾秒，沒有時為 no_deadline()。 Seconds until tick() next has work to do, no_deadline() if never. */
+    double next_deadline () const;
+    /** \brief tickless mode 中重新計算 mach 的 next_deadline()，在 tick() 之外改變 mach 時呼叫。 Recompute next_deadline() of mach in tickless mode, call if mach changed outside of tick(). */
+    void wakeMach (StateMachine *mach);
+    /** \brief tickless mode 中不再排程 mach，machine 停止或重置時自動呼叫。 Stop scheduling mach in tickless mode, called when machine stops or resets. */
+    void sleepMach (StateMachine *mach);
     
 private:
     struct PRIVATE;
     friend struct PRIVATE;
     PRIVATE *private_;
+
+    friend class StateMachine;
+    /** \brief 平行處理中送給其他 machine 的 event 改用 postEvent()，有改用時傳回 true。 During a parallel round, events to other machines are posted by postEvent(), true if posted. */
+    bool   defer_event (StateMachine *mach, int event_id);
+    /** \brief 登記有 posted events 的 machine，可在任何 thread 呼叫。 List a machine with posted events, from any thread. */
+    void   post_ready (StateMachine *mach);
+    /** \brief 從 posted 列表移除將解構的 mach。 Remove mach about to be destructed from the posted list. */
+    void   unpost (StateMachine *mach);
+    /** \brief 平行處理中保護共用資料的 mutex，否則為 0。 Mutex guarding shared data during a parallel round, 0 otherwise. */
+    Mutex *pump_lock ();
 };
 
 }
@@ -0,0 +1,205 @@
+#ifndef TimerQueue_H
+#define TimerQueue_H
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <boost/cstdint.hpp>
+
+namespace scm {
+
+/** \brief 沒有 deadline 時傳回的值。 Value returned when there is no deadline. */
+inline double no_deadline ()
+{
+    return std::numeric_limits<double>::infinity ();
+}
+
+/** timer_handle
+ * 計時器的 handle，低 32 位元為位置，高 32 位元為該位置的世代。計時器到期或取消後位置可重複使用，但世代不同，舊的 handle 不會誤取消新的計時器。0 永遠無效。
+ * Handle of a timer, slot in low 32 bits and generation of the slot in high 32 bits. A slot is reused after its timer is due or canceled, but with another generation,
+ * so a stale handle never cancels a newer timer. 0 is never valid.
+ */
+typedef boost::uint64_t timer_handle;
+
+/** TimerQueue
+ * 依時間排序的 binary heap，加入及取消都是 O(log n)。同時間的項目依加入順序取出。push() 傳回的 handle 可用於 cancel()。
+ * Binary heap ordered by time, push and cancel are O(log n). Entries of the same time pop in order of push. Handle returned by push() can be used by cancel().
+ */
+template <typename T> class TimerQueue
+{
+public:
+    typedef timer_handle handle;
+
+    TimerQueue ()
+        : seq_(0)
+    {
+    }
+
+    handle push (double time, T const &value)
+    {
+        size_t slot;
+        if (free_slots_.empty ()) {
+            slot = pos_.size ();
+            pos_.push_back (0);
+            gens_.push_back (0);
+        } else {
+            slot = free_slots_.back ();
+            free_slots_.pop_back ();
+        }
+        Node n = { time, seq_++, slot, value };
+        heap_.push_back (n);
+        sift_up (heap_.size () - 1);
+        return (handle (gens_[slot]) << 32) | handle (slot + 1);
+    }
+
+    /** \brief 已取出或取消的 handle 傳回 false。取消的項目存入 value。 false if h was already popped or canceled. The canceled entry is stored to value. */
+    bool cancel (handle h, T *value=0)
+    {
+        if (!contains (h)) return false;
+        size_t i = pos_[size_t (h & 0xffffffffu) - 1];
+        if (value) *value = heap_[i].value_;
+        remove_at (i);
+        return true;
+    }
+
+    /** \brief h 尚未到期或取消。 h is neither popped nor canceled yet. */
+    bool contains (handle h) const
+    {
+        size_t slot = size_t (h & 0xffffffffu) - 1;
+        return slot < pos_.size () && pos_[slot] != npos && gens_[slot] == boost::uint32_t (h >> 32);
+    }
+
+    /** \brief 移除所有 pred(value) 為真的項目，O(n)。 Remove all entries for which pred(value) is true, O(n). */
+    template <typename Pred> void remove_if (Pred pred)
+    {
+        size_t n = 0;
+        for (size_t i=0; i < heap_.size (); ++i) {
+            if (pred (heap_[i].value_)) {
+                free_slot (heap_[i].slot_);
+            } else {
+                place (n++, heap_[i]);
+            }
+        }
+        heap_.erase (heap_.begin () + n, heap_.end ());
+        for (size_t i = n / 2; i-- > 0;) {
+            sift_down (i);
+        }
+    }
+
+    bool empty () const {
+        return heap_.empty ();
+    }
+
+    size_t size () const {
+        return heap_.size ();
+    }
+
+    double top_time () const {
+        return heap_.front ().time_;
+    }
+
+    T const &top () const {
+        return heap_.front ().value_;
+    }
+
+    void pop ()
+    {
+        assert (!heap_.empty ());
+        remove_at (0);
+    }
+
+    /** \brief 移除所有項目，已發出的 handle 都失效。 Remove all entries, every handle given out becomes invalid. */
+    void clear ()
+    {
+        for (size_t i=0; i < heap_.size (); ++i) {
+            free_slot (heap_[i].slot_);
+        }
+        heap_.clear ();
+    }
+
+private:
+    static size_t const npos = size_t (-1);
+
+    struct Node
+    {
+        double time_;
+        size_t seq_;
+        size_t slot_;
+        T      value_;
+
+        bool operator< (Node const &rhs) const
+        {
+            return time_ < rhs.time_ || (time_ == rhs.time_ && seq_ < rhs.seq_);
+        }
+    };
+
+    void place (size_t i, Node const &n)
+    {
+        heap_[i] = n;
+        pos_[n.slot_] = i;
+    }
+
+    void sift_up (size_t i)
+    {
+        Node n = heap_[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!(n < heap_[parent])) break;
+            place (i, heap_[parent]);
+            i = parent;
+        }
+        place (i, n);
+    }
+
+    void sift_down (size_t i)
+    {
+        Node n = heap_[i];
+        size_t size = heap_.size ();
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= size) break;
+            if (child + 1 < size && heap_[child + 1] < heap_[child]) ++child;
+            if (!(heap_[child] < n)) break;
+            place (i, heap_[child]);
+            i = child;
+        }
+        place (i, n);
+    }
+
+    void free_slot (size_t slot)
+    {
+        pos_[slot] = npos;
+        ++gens_[slot];
+        free_slots_.push_back (slot);
+    }
+
+    void remove_at (size_t i)
+    {
+        free_slot (heap_[i].slot_);
+
+        size_t last = heap_.size () - 1;
+        if (i != last) {
+            bool up = heap_[last] < heap_[i];
+            place (i, heap_[last]);
+            heap_.pop_back ();
+            if (up) {
+                sift_up (i);
+            } else {
+                sift_down (i);
+            }
+        } else {
+            heap_.pop_back ();
+        }
+    }
+
+    std::vector<Node>   heap_;
+    std::vector<size_t> pos_; // heap index of each handle slot, npos if free
+    std::vector<boost::uint32_t> gens_; // generation of each handle slot
+    std::vector<size_t> free_slots_;
+    size_t              seq_;
+};
+
+}
+
+#endif
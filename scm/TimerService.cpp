@@ -0,0 +1,72 @@
+#include "TimerService.h"
+
+namespace scm {
+
+struct TimerService::ReleaseIfAction
+{
+    bool operator () (Entry const &e) const
+    {
+        if (e.machine_) return false;
+        if (e.cancel_) e.cancel_->release ();
+        return true;
+    }
+};
+
+TimerService::TimerService ()
+    : now_(0)
+{
+}
+
+TimerService::~TimerService ()
+{
+    clear ();
+}
+
+TimerService::handle TimerService::schedule (double time, action_slot const &act, RefCountObject *cancel, bool machine)
+{
+    Entry e;
+    e.act_ = act;
+    e.cancel_ = cancel;
+    e.machine_ = machine;
+    return timers_.push (time, e);
+}
+
+bool TimerService::cancel (handle h)
+{
+    Entry e;
+    if (!timers_.cancel (h, &e)) return false;
+    if (e.cancel_) e.cancel_->release ();
+    return true;
+}
+
+void TimerService::advance (double t)
+{
+    now_ += t;
+    while (!timers_.empty () && timers_.top_time () <= now_) {
+        Entry e = timers_.top ();
+        timers_.pop ();
+        if (!e.cancel_) {
+            e.act_ ();
+        } else {
+            if (!e.cancel_->unique_ref ()) {
+                e.act_ ();
+            }
+            e.cancel_->release ();
+        }
+    }
+}
+
+void TimerService::clearActions ()
+{
+    timers_.remove_if (ReleaseIfAction ());
+}
+
+void TimerService::clear ()
+{
+    for (; !timers_.empty (); timers_.pop ()) {
+        if (timers_.top ().cancel_) timers_.top ().cancel_->release ();
+    }
+    timers_.clear ();
+}
+
+}
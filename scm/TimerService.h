@@ -0,0 +1,68 @@
+#ifndef TimerService_H
+#define TimerService_H
+
+#include "RefCountObject.h"
+#include "InlineFunction.h"
+#include "TimerQueue.h"
+
+namespace scm {
+
+/** TimerService
+ * StateMachineManager 中所有 machine 及 PunctualFrameMover 共用的計時器。時間只在 advance() 時前進，到期的動作依時間順序執行。
+ * Timers shared by every machine of a StateMachineManager and by PunctualFrameMover. Time only moves on advance(), due actions run in order of time.
+ * @see StateMachineManager::pumpTimers()
+ */
+class TimerService
+{
+public:
+    typedef timer_handle handle;
+
+    TimerService ();
+    ~TimerService ();
+
+    inline double now () const {
+        return now_;
+    }
+
+    /** 在時間 time 執行 act。若給了 cancel，其一個 reference 交給 TimerService，到期時只有在其他人仍 retain 它時才執行。
+     * machine 為真表示由 StateMachine 排程，不會被 clearActions() 清除。
+     * Run act at time. If cancel is given, one reference of it is passed to TimerService and act only runs if someone else still retains it when due.
+     * machine is true for timers scheduled by StateMachine, which clearActions() leaves alone.
+     */
+    handle schedule (double time, action_slot const &act, RefCountObject *cancel=0, bool machine=false);
+    bool cancel (handle h);
+
+    /** \brief 時間前進 t 秒並執行到期的動作。 Move time forward t seconds and run due actions. */
+    void advance (double t);
+
+    bool empty () const {
+        return timers_.empty ();
+    }
+    /** \brief 最早的到期時間，沒有計時器時無意義。 Earliest deadline, meaningless if empty. */
+    double next_deadline () const {
+        return timers_.top_time ();
+    }
+
+    /** \brief 清除非 machine 排程的計時器。 Clear timers not scheduled by machines. */
+    void clearActions ();
+    void clear ();
+
+private:
+    struct Entry
+    {
+        action_slot     act_;
+        RefCountObject *cancel_;
+        bool            machine_;
+    };
+    struct ReleaseIfAction;
+
+    TimerQueue<Entry> timers_;
+    double            now_;
+
+    TimerService (TimerService const &);
+    TimerService &operator= (TimerService const &);
+};
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "WorkerPool.h"
+#include <vector>
+#include <algorithm>
+
+#ifdef SCM_USE_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif
+
+namespace scm {
+
+Mutex::Mutex ()
+    : mutex_(0)
+{
+#ifdef SCM_USE_THREADS
+    mutex_ = new boost::mutex;
+#endif
+}
+
+Mutex::~Mutex ()
+{
+#ifdef SCM_USE_THREADS
+    delete static_cast<boost::mutex *>(mutex_);
+#endif
+}
+
+void Mutex::lock ()
+{
+#ifdef SCM_USE_THREADS
+    static_cast<boost::mutex *>(mutex_)->lock ();
+#endif
+}
+
+void Mutex::unlock ()
+{
+#ifdef SCM_USE_THREADS
+    static_cast<boost::mutex *>(mutex_)->unlock ();
+#endif
+}
+
+struct WorkerPool::PRIVATE
+{
+#ifdef SCM_USE_THREADS
+    // indices [first_, last_) left to a worker, the owner takes from the front and thieves from the back
+    struct Range
+    {
+        boost::mutex mutex_;
+        size_t       first_;
+        size_t       last_;
+
+        Range ()
+            : first_(0), last_(0)
+        {
+        }
+    };
+
+    std::vector<boost::thread *> threads_;
+    std::vector<Range *>         ranges_; // 0 for the thread calling run (), i + 1 for threads_[i]
+    boost::mutex                 mutex_;
+    boost::condition_variable    start_;
+    boost::condition_variable    done_;
+    task_type                    task_;
+    size_t                       running_; // workers not done with this round
+    size_t                       round_;
+    bool                         quit_;
+
+    PRIVATE ()
+        : running_(0)
+        , round_(0)
+        , quit_(false)
+    {
+        ranges_.push_back (new Range);
+    }
+
+    ~PRIVATE ()
+    {
+        for (size_t i=0; i < ranges_.size (); ++i) {
+            delete ranges_[i];
+        }
+    }
+
+    void worker_main (size_t self, size_t seen);
+    void work (size_t self);
+    bool take (size_t self, size_t &index);
+    bool steal (size_t self, size_t &index);
+    void stop ();
+#endif
+};
+
+#ifdef SCM_USE_THREADS
+void WorkerPool::PRIVATE::worker_main (size_t self, size_t seen)
+{
+    for (;;) {
+        {
+            boost::mutex::scoped_lock lock (mutex_);
+            while (!quit_ && round_ == seen) start_.wait (lock);
+            if (quit_) return;
+            seen = round_;
+        }
+        work (self);
+        boost::mutex::scoped_lock lock (mutex_);
+        if (--running_ == 0) done_.notify_all ();
+    }
+}
+
+void WorkerPool::PRIVATE::work (size_t self)
+{
+    size_t index;
+    while (take (self, index) || steal (self, index)) {
+        task_ (index);
+    }
+}
+
+bool WorkerPool::PRIVATE::take (size_t self, size_t &index)
+{
+    Range &r = *ranges_[self];
+    boost::mutex::scoped_lock lock (r.mutex_);
+    if (r.first_ == r.last_) return false;
+    index = r.first_++;
+    return true;
+}
+
+bool WorkerPool::PRIVATE::steal (size_t self, size_t &index)
+{
+    // the own range is empty, nobody else adds to it
+    for (size_t k=1; k < ranges_.size (); ++k) {
+        Range &victim = *ranges_[(self + k) % ranges_.size ()];
+        size_t first, last;
+        {
+            boost::mutex::scoped_lock lock (victim.mutex_);
+            size_t left = victim.last_ - victim.first_;
+            if (left == 0) continue;
+            last = victim.last_;
+            first = last - (left + 1) / 2;
+            victim.last_ = first;
+        }
+        Range &r = *ranges_[self];
+        boost::mutex::scoped_lock lock (r.mutex_);
+        r.first_ = first + 1;
+        r.last_ = last;
+        index = first;
+        return true;
+    }
+    return false;
+}
+
+void WorkerPool::PRIVATE::stop ()
+{
+    {
+        boost::mutex::scoped_lock lock (mutex_);
+        quit_ = true;
+    }
+    start_.notify_all ();
+    for (size_t i=0; i < threads_.size (); ++i) {
+        threads_[i]->join ();
+        delete threads_[i];
+    }
+    threads_.clear ();
+    for (size_t i=1; i < ranges_.size (); ++i) {
+        delete ranges_[i];
+    }
+    ranges_.resize (1);
+    quit_ = false;
+}
+#endif
+
+WorkerPool::WorkerPool ()
+{
+    private_ = new PRIVATE;
+}
+
+WorkerPool::~WorkerPool ()
+{
+    resize (0);
+    delete private_;
+}
+
+void WorkerPool::resize (size_t threads)
+{
+#ifdef SCM_USE_THREADS
+    if (threads == private_->threads_.size ()) return;
+    private_->stop ();
+    for (size_t i=0; i < threads; ++i) {
+        private_->ranges_.push_back (new PRIVATE::Range);
+        private_->threads_.push_back (new boost::thread (boost::bind (&PRIVATE::worker_main, private_, i + 1, private_->round_)));
+    }
+#else
+    (void)threads;
+#endif
+}
+
+size_t WorkerPool::size () const
+{
+#ifdef SCM_USE_THREADS
+    return private_->threads_.size ();
+#else
+    return 0;
+#endif
+}
+
+void WorkerPool::run (size_t count, task_type const &task)
+{
+#ifdef SCM_USE_THREADS
+    PRIVATE *p = private_;
+    if (!p->threads_.empty () && count > 1) {
+        {
+            boost::mutex::scoped_lock lock (p->mutex_);
+            p->task_ = task;
+            // an even share each to start with, workers done early steal half of what is left to others
+            size_t num = p->ranges_.size ();
+            for (size_t i=0; i < num; ++i) {
+                p->ranges_[i]->first_ = count * i / num;
+                p->ranges_[i]->last_ = count * (i + 1) / num;
+            }
+            p->running_ = p->threads_.size ();
+            ++p->round_;
+        }
+        p->start_.notify_all ();
+        p->work (0);
+        boost::mutex::scoped_lock lock (p->mutex_);
+        while (p->running_) p->done_.wait (lock);
+        return;
+    }
+#endif
+    for (size_t i=0; i < count; ++i) {
+        task (i);
+    }
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef WorkerPool_H
+#define WorkerPool_H
+
+#include "InlineFunction.h"
+#include <cstddef>
+
+namespace scm {
+
+/** Mutex
+ * 定義 SCM_USE_THREADS 時為 boost::mutex，否則什麼都不做。
+ * A boost::mutex if SCM_USE_THREADS is defined, does nothing otherwise.
+ */
+class Mutex
+{
+public:
+    Mutex ();
+    ~Mutex ();
+
+    void lock ();
+    void unlock ();
+
+private:
+    void *mutex_;
+
+    Mutex (Mutex const &);
+    Mutex &operator= (Mutex const &);
+};
+
+/** \brief mutex 不為 0 時在 scope 內鎖住它。 Lock mutex within the scope unless it's 0. */
+class MutexLock
+{
+public:
+    explicit MutexLock (Mutex *mutex)
+        : mutex_(mutex)
+    {
+        if (mutex_) mutex_->lock ();
+    }
+    ~MutexLock ()
+    {
+        if (mutex_) mutex_->unlock ();
+    }
+
+private:
+    Mutex *mutex_;
+
+    MutexLock (MutexLock const &);
+    MutexLock &operator= (MutexLock const &);
+};
+
+/** WorkerPool
+ * 固定數量的 worker threads。run() 把 [0, count) 平均分給各 worker 及呼叫的 thread，先做完的向其他人偷取剩下的一半，全部完成後才返回。
+ * 每個 index 只在一個 thread 上執行一次。沒有定義 SCM_USE_THREADS 時沒有 worker，run() 在呼叫的 thread 上依序執行。
+ * A fixed number of worker threads. run() splits [0, count) evenly between the workers and the calling thread, those done first steal half of what others have left,
+ * and it returns when all are done. Each index runs once on one thread. Without SCM_USE_THREADS there are no workers, run() runs everything in order on the calling thread.
+ */
+class WorkerPool
+{
+public:
+    typedef InlineFunction<void (size_t)> task_type;
+
+    WorkerPool ();
+    ~WorkerPool ();
+
+    /** \brief 改變 worker threads 數，不可在 run() 中呼叫。 Change the number of worker threads, not from within run(). */
+    void   resize (size_t threads);
+    size_t size () const;
+
+    void run (size_t count, task_type const &task);
+
+private:
+    struct PRIVATE;
+    PRIVATE *private_;
+
+    WorkerPool (WorkerPool const &);
+    WorkerPool &operator= (WorkerPool const &);
+};
+
+}
+
+#endif
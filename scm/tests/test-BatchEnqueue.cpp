@@ -0,0 +1,81 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string chain_scxml = "\
+   <scxml> \
+       <state id='s0'> \
+           <transition event='a' target='s1'/> \
+       </state> \
+       <state id='s1'> \
+           <transition event='b' target='s2'/> \
+       </state> \
+       <state id='s2'> \
+           <transition event='c' target='s3'/> \
+       </state> \
+       <state id='s3'> \
+       </state> \
+    </scxml> \
+";
+
+int entered_ = 0;
+void onentry_s1 () { ++entered_; }
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("chain", chain_scxml);
+
+    StateMachine *machs[3];
+    for (int i=0; i < 3; ++i) {
+        machs[i] = manager->getMach("chain");
+        machs[i]->retain();
+        machs[i]->set_allow_nop_entry_exit(true);
+        machs[i]->setActionSlot("onentry_s1", &onentry_s1);
+        machs[i]->StartEngine();
+    }
+
+    // the same event to many machines
+    manager->enqueEvent(machs, 3, manager->event_id("a"));
+    manager->pumpMachEvents();
+    CHECK(entered_ == 3);
+    for (int i=0; i < 3; ++i) {
+        CHECK(machs[i]->inState("s1"));
+    }
+
+    // many events to one machine, in order
+    int ids[] = { manager->event_id("b"), manager->event_id("c") };
+    machs[0]->enqueEvents(ids, 2);
+    std::string names[] = { "b", "c" };
+    machs[1]->enqueEvents(names, 2);
+    machs[2]->enqueEvents(ids, 0);
+    manager->pumpMachEvents();
+    CHECK(machs[0]->inState("s3") && machs[1]->inState("s3") && machs[2]->inState("s1"));
+
+    // names straight from a buffer, known names need no std::string
+    size_t events = manager->num_of_events();
+    char const *buffer = "xxbcyy";
+    machs[2]->enqueEvent(buffer + 2, 1);
+    machs[2]->enqueEvent(buffer + 3, 1);
+    manager->pumpMachEvents();
+    CHECK(machs[2]->inState("s3"));
+    CHECK(manager->num_of_events() == events);
+    CHECK(manager->event_id(buffer, 2) == manager->event_id("xx"));
+
+    // slots are dropped by default when reset, as by recycleMach()
+    action_slot s;
+    machs[0]->ResetEngine();
+    CHECK(!machs[0]->GetActionSlot("onentry_s1", s));
+    machs[1]->ResetEngine(true);
+    CHECK(machs[1]->GetActionSlot("onentry_s1", s));
+
+    for (int i=0; i < 3; ++i) {
+        machs[i]->release();
+    }
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
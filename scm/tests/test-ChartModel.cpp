@@ -0,0 +1,72 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string light_scxml = "\
+   <scxml> \
+       <state id='red'> \
+           <transition event='next' target='green'/> \
+       </state> \
+       <state id='green'> \
+           <transition event='next' target='yellow'/> \
+           <state id='walk'/> \
+           <state id='hurry'/> \
+       </state> \
+       <state id='yellow'> \
+           <transition event='next' target='red'/> \
+       </state> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("light", light_scxml);
+    manager->set_scxml("other_light", light_scxml);
+
+    StateMachine *a = manager->getMach("light");
+    StateMachine *b = manager->getMach("light");
+    StateMachine *c = manager->getMach("other_light");
+    a->retain();
+    b->retain();
+    c->retain();
+
+    // one model per scxml_id, shared by its machines
+    ChartModel const *model = a->model();
+    CHECK(model != 0);
+    CHECK(b->model() == model);
+    CHECK(c->model() != 0 && c->model() != model);
+    CHECK(model->scxml_id() == "light");
+
+    // states numbered in document order, the machine itself first
+    CHECK(model->num_of_states() == 6);
+    CHECK(model->state_index("red") == 1);
+    CHECK(model->state_index("green") == 2);
+    CHECK(model->state_index("walk") == 3);
+    CHECK(model->state_index("hurry") == 4);
+    CHECK(model->state_index("yellow") == 5);
+    CHECK(model->state_index("blue") == -1);
+    CHECK(model->parent(model->state_index("walk")) == model->state_index("green"));
+    CHECK(model->parent(model->state_index("green")) == 0);
+    for (size_t i=1; i < model->num_of_states(); ++i) {
+        CHECK(a->getState((int)i) == a->getState(model->state_uid((int)i)));
+        CHECK(a->getState((int)i)->state_index() == (int)i);
+    }
+
+    a->StartEngine();
+    b->StartEngine();
+    a->enqueEvent("next");
+    manager->pumpMachEvents();
+    CHECK(a->inState("walk"));
+    CHECK(b->inState("red"));
+
+    a->release();
+    b->release();
+    c->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,78 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string gate_scxml = "\
+   <scxml> \
+       <state id='wait'> \
+           <transition cond='ready' target='go'/> \
+       </state> \
+       <state id='go'> \
+           <transition event='back' target='wait'/> \
+       </state> \
+    </scxml> \
+";
+
+bool ready_ = false;
+int asked_ = 0;
+
+bool ready ()
+{
+    ++asked_;
+    return ready_;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("gate", gate_scxml);
+
+    // polled by default, checked every frame
+    StateMachine *polled = manager->getMach("gate");
+    polled->retain();
+    polled->setCondSlot("ready", &ready);
+    polled->StartEngine();
+    polled->frame_move(0);
+    polled->frame_move(0);
+    CHECK(polled->inState("wait") && asked_ >= 2);
+    ready_ = true;
+    polled->frame_move(0);
+    CHECK(polled->inState("go"));
+
+    // not polled, checked once after a configuration change and after invalidateCond()
+    ready_ = false;
+    asked_ = 0;
+    StateMachine *lazy = manager->getMach("gate");
+    lazy->retain();
+    lazy->setCondSlot("ready", &ready);
+    lazy->setCondPolling("ready", false);
+    lazy->setCondPolling("not_in_scxml", false);
+    lazy->StartEngine();
+    lazy->frame_move(0);
+    int asked = asked_;
+    CHECK(asked >= 1);
+    lazy->frame_move(0);
+    lazy->frame_move(0);
+    CHECK(asked_ == asked);
+    ready_ = true;
+    lazy->frame_move(0);
+    CHECK(lazy->inState("wait") && asked_ == asked);
+    lazy->invalidateCond("ready");
+    lazy->frame_move(0);
+    CHECK(lazy->inState("go"));
+
+    // entering the state again counts as a change
+    lazy->enqueEvent("back");
+    manager->pumpMachEvents();
+    lazy->frame_move(0);
+    CHECK(lazy->inState("go"));
+
+    polled->release();
+    lazy->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,91 @@
+#include <scm/StateMachineManager.h>
+#include <scm/Delegate.h>
+#include "test_check.h"
+
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+std::string hook_scxml = "\
+   <scxml> \
+       <state id='first'> \
+           <transition event='next' target='second'/> \
+       </state> \
+       <state id='second'> \
+       </state> \
+    </scxml> \
+";
+
+std::vector<int> calls_;
+DelegateList<void ()> *list_ = 0;
+DelegateList<void ()>::connection late_ = 0;
+
+void record (int i)
+{
+    calls_.push_back (i);
+}
+
+void add_late ()
+{
+    calls_.push_back (2);
+    if (!late_) late_ = list_->connect (boost::bind (&record, 9));
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    DelegateList<void ()> list;
+    list_ = &list;
+    CHECK(list.empty());
+    list(); // nothing connected
+
+    DelegateList<void ()>::connection c1 = list.connect (boost::bind (&record, 1));
+    DelegateList<void ()>::connection c2 = list.connect (&add_late);
+    DelegateList<void ()>::connection c3 = list.connect (boost::bind (&record, 3));
+    CHECK(c1 && c2 && c3 && c1 != c2 && c2 != c3);
+    CHECK(list.num_slots() == 3);
+
+    // called in order, a slot connected during a call is called in that call
+    list();
+    CHECK(calls_.size() == 4 && calls_[0] == 1 && calls_[1] == 2 && calls_[2] == 3 && calls_[3] == 9);
+    CHECK(list.num_slots() == 4);
+
+    // disconnecting the first slot keeps the others in order
+    calls_.clear();
+    list.disconnect (c1);
+    list.disconnect (late_);
+    list();
+    CHECK(calls_.size() == 2 && calls_[0] == 2 && calls_[1] == 3);
+    list.disconnect_all_slots();
+    CHECK(list.empty());
+
+    DelegateList<void (float)> frames;
+    float total = 0;
+    struct Add { float *total_; void operator () (float t) const { *total_ += t; } };
+    Add add = { &total };
+    frames.connect (add);
+    frames.connect (add);
+    frames (0.5f);
+    CHECK(total == 1.0f);
+
+    // hooks of states
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("hook", hook_scxml);
+    StateMachine *mach = manager->getMach("hook");
+    mach->retain();
+    mach->prepareEngine();
+    calls_.clear();
+    mach->getState("first")->signal_onexit.connect (boost::bind (&record, 10));
+    mach->getState("second")->signal_onentry.connect (boost::bind (&record, 20));
+    mach->StartEngine();
+    mach->enqueEvent("next");
+    manager->pumpMachEvents();
+    CHECK(calls_.size() == 2 && calls_[0] == 10 && calls_[1] == 20);
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
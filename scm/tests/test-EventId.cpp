@@ -0,0 +1,58 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string switch_scxml = "\
+   <scxml> \
+       <state id='off'> \
+           <transition event='turn_on' target='on'/> \
+       </state> \
+       <state id='on'> \
+           <transition event='turn_off' target='off'/> \
+       </state> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("switch", switch_scxml);
+
+    // interning
+    CHECK(manager->event_id("") == 0);
+    int turn_on = manager->event_id("turn_on");
+    int turn_off = manager->event_id("turn_off");
+    CHECK(turn_on > 0 && turn_off > 0 && turn_on != turn_off);
+    CHECK(manager->event_id("turn_on") == turn_on);
+    CHECK(manager->event_name(turn_on) == "turn_on");
+    size_t num = manager->num_of_events();
+    int unknown = manager->event_id("unknown");
+    CHECK(manager->num_of_events() == num + 1);
+    CHECK(manager->event_name(unknown) == "unknown");
+
+    StateMachine *mach = manager->getMach("switch");
+    mach->retain();
+    CHECK(mach->event_id("turn_on") == turn_on);
+    mach->StartEngine();
+    CHECK(mach->inState("off"));
+
+    // by id and by name take the same transitions
+    mach->enqueEvent(turn_on);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("on"));
+    mach->enqueEvent("turn_off");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("off"));
+    mach->enqueEvent(unknown);
+    mach->enqueEvent(turn_on);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("on"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
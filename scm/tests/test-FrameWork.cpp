@@ -0,0 +1,73 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string split_scxml = "\
+   <scxml> \
+       <parallel> \
+           <state id='moving'> \
+               <state id='walk'/> \
+           </state> \
+           <state id='still'> \
+               <state id='sit'/> \
+           </state> \
+       </parallel> \
+    </scxml> \
+";
+
+int walk_ = 0;
+int moving_hook_ = 0;
+int still_hook_ = 0;
+int sit_hook_ = 0;
+
+void walk (float) { ++walk_; }
+
+struct Count
+{
+    int *n_;
+    Count (int *n) : n_(n) {}
+    void operator () (float) const { ++*n_; }
+};
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("split", split_scxml);
+
+    // only 'walk' has a bound frame_move slot, by its default name
+    StateMachine *mach = manager->getMach("split");
+    mach->retain();
+    mach->setFrameMoveSlot("walk", &walk);
+    mach->StartEngine();
+    mach->getState("moving")->signal_on_frame_move_.connect (Count (&moving_hook_));
+    mach->getState("still")->signal_on_frame_move_.connect (Count (&still_hook_));
+    mach->getState("sit")->signal_on_frame_move_.connect (Count (&sit_hook_));
+
+    mach->frame_move(0.1f);
+    CHECK(walk_ == 1 && moving_hook_ == 1);
+    CHECK(still_hook_ == 0 && sit_hook_ == 0);
+
+    // a hooked state asks for frames explicitly, its parents follow
+    mach->getState("sit")->require_frame_move();
+    mach->frame_move(0.1f);
+    CHECK(walk_ == 2 && moving_hook_ == 2);
+    CHECK(still_hook_ == 1 && sit_hook_ == 1);
+
+    // a machine without any slot bound needs no frames at all
+    StateMachine *idle = manager->getMach("split");
+    idle->retain();
+    idle->StartEngine();
+    int idle_walk = 0;
+    idle->getState("walk")->signal_on_frame_move_.connect (Count (&idle_walk));
+    idle->frame_move(0.1f);
+    CHECK(idle_walk == 0);
+
+    mach->release();
+    idle->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
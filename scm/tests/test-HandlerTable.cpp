@@ -0,0 +1,86 @@
+#include <scm/StateMachineManager.h>
+#include <scm/HandlerTable.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string turnstile_scxml = "\
+   <scxml> \
+       <state id='locked'> \
+           <transition event='coin' cond='paid' target='unlocked'/> \
+       </state> \
+       <state id='unlocked' frame_move='spin'> \
+           <transition event='push' target='locked'/> \
+       </state> \
+    </scxml> \
+";
+
+struct Turnstile
+{
+    int unlocked_;
+    int locked_;
+    float spun_;
+    bool paid_;
+    Turnstile () : unlocked_(0), locked_(0), spun_(0), paid_(true) {}
+    void onentry_unlocked () { ++unlocked_; }
+    void onentry_locked () { ++locked_; }
+    void spin (float t) { spun_ += t; }
+    bool paid () const { return paid_; }
+};
+
+int overridden_ = 0;
+void count_override () { ++overridden_; }
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("turnstile", turnstile_scxml);
+
+    HandlerTable *table = manager->handlerTable("turnstile");
+    CHECK(table != 0 && table->handler_type () == 0);
+    CHECK(manager->handlerTable("turnstile") == table);
+    REGISTER_ACTION_HANDLER(table, "onentry_unlocked", &Turnstile::onentry_unlocked);
+    REGISTER_ACTION_HANDLER(table, "onentry_locked", &Turnstile::onentry_locked);
+    REGISTER_ACTION_HANDLER(table, "not_in_scxml", &Turnstile::onentry_locked); // ignored
+    REGISTER_FRAME_MOVE_HANDLER(table, "spin", &Turnstile::spin);
+    REGISTER_COND_HANDLER(table, "paid", &Turnstile::paid);
+    CHECK(table->handler_type () && *table->handler_type () == typeid (Turnstile));
+    CHECK(table->action (-1) == 0);
+
+    // every machine calls the shared table on its own handler object
+    Turnstile a, b;
+    b.paid_ = false;
+    StateMachine *mach_a = manager->getMach("turnstile");
+    StateMachine *mach_b = manager->getMach("turnstile");
+    mach_a->retain();
+    mach_b->retain();
+    mach_a->attachHandler (&a);
+    mach_b->attachHandler (&b);
+    // a slot set on the machine itself takes precedence
+    mach_b->setActionSlot("onentry_locked", &count_override);
+    mach_a->StartEngine();
+    mach_b->StartEngine();
+    CHECK(a.locked_ == 1 && b.locked_ == 0 && overridden_ == 1);
+
+    mach_a->enqueEvent("coin");
+    mach_b->enqueEvent("coin");
+    manager->pumpMachEvents();
+    CHECK(mach_a->inState("unlocked") && a.unlocked_ == 1);
+    CHECK(mach_b->inState("locked") && b.unlocked_ == 0);
+
+    mach_a->frame_move(0.5f);
+    mach_b->frame_move(0.5f);
+    CHECK(a.spun_ == 0.5f && b.spun_ == 0);
+
+    mach_a->enqueEvent("push");
+    manager->pumpMachEvents();
+    CHECK(mach_a->inState("locked") && a.locked_ == 2);
+
+    mach_a->release();
+    mach_b->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
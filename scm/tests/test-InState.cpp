@@ -0,0 +1,79 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string drill_scxml = "\
+   <scxml> \
+       <parallel> \
+           <state id='power'> \
+               <state id='off'> \
+                   <transition event='switch' target='on'/> \
+               </state> \
+               <state id='on'> \
+                   <transition event='switch' target='off'/> \
+                   <state id='low'> \
+                       <transition event='boost' target='high'/> \
+                   </state> \
+                   <state id='high'/> \
+               </state> \
+           </state> \
+           <state id='motor'> \
+               <state id='stopped'> \
+                   <transition event='start' cond='In(on)' target='spinning'/> \
+                   <transition event='check' cond='In(low|high)' target='ready'/> \
+               </state> \
+               <state id='spinning'> \
+                   <transition cond='!In(on)' target='stopped'/> \
+               </state> \
+               <state id='ready'/> \
+           </state> \
+       </parallel> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("drill", drill_scxml);
+
+    StateMachine *mach = manager->getMach("drill");
+    mach->retain();
+    mach->set_allow_nop_entry_exit(true);
+    mach->StartEngine();
+    CHECK(mach->inState("off") && mach->inState("stopped") && mach->inState("power"));
+    CHECK(!mach->inState("on") && !mach->inState("low"));
+
+    mach->enqueEvent("start");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("stopped"));
+
+    // ancestors of the active states are active too
+    mach->enqueEvent("switch");
+    mach->enqueEvent("start");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("on") && mach->inState("low") && mach->inState("spinning"));
+
+    // !In() eventless transition follows the other region
+    mach->enqueEvent("switch");
+    manager->pumpMachEvents();
+    mach->frame_move(0);
+    CHECK(mach->inState("off") && !mach->inState("low") && mach->inState("stopped"));
+
+    // In(a|b) is true if any of them is active
+    mach->enqueEvent("check");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("stopped"));
+    mach->enqueEvent("switch");
+    mach->enqueEvent("boost");
+    mach->enqueEvent("check");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("high") && mach->inState("ready"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
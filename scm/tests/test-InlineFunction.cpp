@@ -0,0 +1,102 @@
+#include <scm/StateMachineManager.h>
+#include <scm/InlineFunction.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string light_scxml = "\
+   <scxml> \
+       <state id='off'> \
+           <transition event='flip' target='on'/> \
+       </state> \
+       <state id='on'> \
+           <transition event='flip' cond='allowed' target='off'/> \
+       </state> \
+    </scxml> \
+";
+
+int live_ = 0;
+
+struct Counter
+{
+    int *hits_;
+    Counter (int *hits) : hits_(hits) { ++live_; }
+    Counter (Counter const &rhs) : hits_(rhs.hits_) { ++live_; }
+    ~Counter () { --live_; }
+    void operator () () const { ++*hits_; }
+};
+
+struct BigCounter: Counter
+{
+    char pad_[8 * sizeof (void *)];
+    BigCounter (int *hits) : Counter (hits) {}
+};
+
+struct Light
+{
+    int entered_;
+    bool allowed_;
+    Light () : entered_(0), allowed_(false) {}
+    void onentry_on () { ++entered_; }
+    bool allowed () const { return allowed_; }
+};
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    int hits = 0;
+    {
+        action_slot empty;
+        CHECK(empty.empty() && !empty);
+
+        action_slot small ((Counter (&hits)));
+        action_slot big ((BigCounter (&hits)));
+        CHECK(!small.empty() && small && big);
+        CHECK(live_ == 2);
+
+        // copies own their functor, small ones inline and big ones on heap
+        action_slot small_copy (small);
+        action_slot big_copy (big);
+        CHECK(live_ == 4);
+        small (); small_copy (); big (); big_copy ();
+        CHECK(hits == 4);
+
+        small_copy = big;
+        CHECK(live_ == 4);
+        small_copy ();
+        CHECK(hits == 5);
+
+        big.clear ();
+        CHECK(big.empty() && live_ == 3);
+        big.swap (small);
+        CHECK(small.empty() && !big.empty());
+        big ();
+        CHECK(hits == 6);
+    }
+    CHECK(live_ == 0);
+
+    // make_slot as action and cond slots
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("light", light_scxml);
+    Light light;
+    StateMachine *mach = manager->getMach("light");
+    mach->retain();
+    mach->setActionSlot("onentry_on", make_slot (&Light::onentry_on, &light));
+    mach->setCondSlot("allowed", make_slot (&Light::allowed, &light));
+    mach->StartEngine();
+    mach->enqueEvent("flip");
+    mach->enqueEvent("flip");
+    manager->pumpMachEvents();
+    CHECK(light.entered_ == 1 && mach->inState("on"));
+    light.allowed_ = true;
+    mach->enqueEvent("flip");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("off"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,68 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string door_scxml = "\
+   <scxml> \
+       <state id='open' leaving_delay='1'> \
+           <transition event='close' target='closed'/> \
+       </state> \
+       <state id='closed'> \
+           <transition event='open' target='open'/> \
+       </state> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("door", door_scxml);
+
+    StateMachine *mach = manager->getMach("door");
+    mach->retain();
+    mach->set_allow_nop_entry_exit(true);
+    mach->StartEngine();
+    CHECK(mach->inState("open") && !mach->isLeavingState());
+
+    // stays leaving until the delay is due as a timed event of the machine
+    mach->enqueEvent("close");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("open") && mach->isLeavingState());
+    CHECK(mach->next_deadline() == 1.0);
+    mach->frame_move(0.5f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("open") && mach->isLeavingState());
+
+    // clearTimedEvents() leaves leaving_delay alone
+    mach->clearTimedEvents();
+    mach->frame_move(0.6f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("closed") && !mach->isLeavingState());
+
+    // with shared timers the manager's clock times it
+    StateMachineManager::release_instance();
+    manager = StateMachineManager::instance();
+    manager->setSharedTimers(true);
+    manager->set_scxml("door", door_scxml);
+    StateMachine *shared = manager->getMach("door");
+    shared->retain();
+    shared->set_allow_nop_entry_exit(true);
+    shared->StartEngine();
+    shared->enqueEvent("close");
+    manager->pumpMachEvents();
+    manager->pumpTimers(0.5);
+    manager->pumpMachEvents();
+    CHECK(shared->inState("open"));
+    manager->pumpTimers(0.5);
+    manager->pumpMachEvents();
+    CHECK(shared->inState("closed"));
+
+    mach->release();
+    shared->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
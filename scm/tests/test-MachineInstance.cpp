@@ -0,0 +1,72 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string lamp_scxml = "\
+   <scxml> \
+       <state id='off'> \
+           <transition event='toggle' target='on'/> \
+       </state> \
+       <state id='on'> \
+           <history id='last' type='shallow'/> \
+           <transition event='toggle' target='off'/> \
+           <state id='dim'> \
+               <transition event='brighter' target='bright'/> \
+           </state> \
+           <state id='bright'> \
+           </state> \
+       </state> \
+    </scxml> \
+";
+
+int entered_bright_ = 0;
+
+void onentry_bright ()
+{
+    ++entered_bright_;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("lamp", lamp_scxml);
+
+    StateMachine *a = manager->getMach("lamp");
+    StateMachine *b = manager->getMach("lamp");
+    a->retain();
+    b->retain();
+    a->setActionSlot("onentry_bright", &onentry_bright);
+
+    // each instance has its own states, ids are shared with the model
+    ChartModel const *model = a->model();
+    int dim = model->state_index("dim");
+    CHECK(a->getState(dim) != b->getState(dim));
+    CHECK(&a->getState(dim)->state_uid() == &model->state_uid(dim));
+    CHECK(&b->getState(dim)->state_uid() == &model->state_uid(dim));
+    CHECK(a->history_type("on") == "shallow");
+
+    // runtime state belongs to the instance
+    a->StartEngine();
+    b->StartEngine();
+    a->enqueEvent("toggle");
+    a->enqueEvent("brighter");
+    manager->pumpMachEvents();
+    CHECK(a->inState("bright") && b->inState("off"));
+    CHECK(entered_bright_ == 1);
+    CHECK(!b->getState("on")->active());
+
+    b->enqueEvent("toggle");
+    b->enqueEvent("brighter");
+    manager->pumpMachEvents();
+    CHECK(b->inState("bright"));
+    CHECK(entered_bright_ == 1); // slot was only set on a
+
+    a->release();
+    b->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,86 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string job_scxml = "\
+   <scxml> \
+       <state id='waiting'> \
+           <transition event='start' target='working'/> \
+       </state> \
+       <state id='working'> \
+           <transition event='finish' target='done'/> \
+       </state> \
+       <state id='done'> \
+       </state> \
+    </scxml> \
+";
+
+int started_ = 0;
+
+void onentry_working ()
+{
+    ++started_;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("job", job_scxml);
+
+    StateMachine *first = manager->acquireMach("job");
+    first->retain();
+    first->setActionSlot("onentry_working", &onentry_working);
+    first->StartEngine();
+    first->enqueEvent("start");
+    manager->pumpMachEvents();
+    CHECK(first->inState("working") && started_ == 1);
+
+    // recycled with its pending events, timed events and slots dropped
+    first->enqueEvent("finish");
+    first->scheduleTimedEvent(1, "finish");
+    manager->recycleMach(first);
+    first->release();
+
+    StateMachine *again = manager->acquireMach("job");
+    CHECK(again == first);
+    again->retain();
+    CHECK(!again->engineStarted());
+    CHECK(!again->inState("working"));
+    again->StartEngine();
+    CHECK(again->inState("waiting"));
+    manager->pumpMachEvents();
+    again->frame_move(2);
+    manager->pumpMachEvents();
+    CHECK(again->inState("waiting"));
+    again->enqueEvent("start");
+    manager->pumpMachEvents();
+    CHECK(again->inState("working"));
+    CHECK(started_ == 1);
+
+    // slots can be kept for the next user
+    again->ResetEngine(false);
+    again->setActionSlot("onentry_working", &onentry_working);
+    manager->recycleMach(again, true);
+    again->release();
+    StateMachine *kept = manager->acquireMach("job");
+    CHECK(kept == again);
+    kept->retain();
+    kept->StartEngine();
+    kept->enqueEvent("start");
+    manager->pumpMachEvents();
+    CHECK(started_ == 2);
+
+    // an empty pool hands out new machines
+    StateMachine *other = manager->acquireMach("job");
+    CHECK(other != kept);
+    CHECK(other->model() == kept->model());
+
+    kept->release();
+    manager->clearMachPool();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,108 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+#include <sstream>
+#include <vector>
+#ifdef SCM_USE_THREADS
+#include <boost/thread.hpp>
+#endif
+
+using namespace std;
+using namespace scm;
+
+std::string chain_scxml = "\
+   <scxml> \
+       <state id='s0'> \
+           <transition event='a' target='s1'/> \
+       </state> \
+       <state id='s1'> \
+           <transition event='b' target='s2'/> \
+       </state> \
+       <state id='s2'> \
+           <transition event='c' target='s3'/> \
+       </state> \
+       <state id='s3'> \
+           <transition event='a' target='s1'/> \
+       </state> \
+    </scxml> \
+";
+
+StateMachineManager *manager_ = 0;
+
+// a, b, c in order n times, any reordering leaves the chain stuck
+void post_chain (StateMachine *mach, int n, bool by_id)
+{
+    int a = by_id ? manager_->event_id ("a") : 0;
+    int b = by_id ? manager_->event_id ("b") : 0;
+    int c = by_id ? manager_->event_id ("c") : 0;
+    for (int i=0; i < n; ++i) {
+        if (by_id) {
+            mach->postEvent (a);
+            mach->postEvent (b);
+            mach->postEvent (c);
+        } else {
+            mach->postEvent ("a");
+            mach->postEvent ("b");
+            mach->postEvent ("c");
+        }
+    }
+}
+
+void intern_names (int n)
+{
+    for (int i=0; i < n; ++i) {
+        std::ostringstream name;
+        name << "name_" << i;
+        manager_->event_id (name.str ());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    manager_ = StateMachineManager::instance();
+    manager_->set_scxml("chain", chain_scxml);
+
+    std::vector<StateMachine *> machs;
+    for (int i=0; i < 4; ++i) {
+        machs.push_back (manager_->getMach("chain"));
+        machs.back ()->retain();
+        machs.back ()->set_allow_nop_entry_exit(true);
+        machs.back ()->StartEngine();
+    }
+
+    // posted events keep their order and are handled by pumpMachEvents()
+    post_chain (machs[0], 1, false);
+    CHECK(machs[0]->next_deadline() == 0);
+    manager_->pumpMachEvents();
+    CHECK(machs[0]->inState("s3"));
+
+#ifdef SCM_USE_THREADS
+    // each posting thread keeps its order, while others intern new names
+    int const n = 2000;
+    boost::thread_group posters;
+    for (int i=0; i < 4; ++i) {
+        posters.create_thread (boost::bind (&post_chain, machs[i], n, i % 2 == 0));
+    }
+    posters.create_thread (boost::bind (&intern_names, n));
+    for (int i=0; i < 50; ++i) {
+        manager_->pumpMachEvents();
+        intern_names (n / 50);
+    }
+    posters.join_all ();
+    manager_->pumpMachEvents();
+    for (int i=0; i < 4; ++i) {
+        CHECK(machs[i]->inState("s3"));
+    }
+    CHECK(manager_->event_name (manager_->event_id ("name_7")) == "name_7");
+#endif
+
+    // a machine still listed as posted may outlive the manager
+    post_chain (machs[1], 1, true);
+    for (int i=0; i < 4; ++i) {
+        machs[i]->release();
+    }
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,77 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+std::string bell_scxml = "\
+   <scxml> \
+       <state id='quiet'> \
+           <transition event='ring' target='ringing'/> \
+       </state> \
+       <state id='ringing'> \
+       </state> \
+    </scxml> \
+";
+
+std::vector<int> fired_;
+
+void fire (int i)
+{
+    fired_.push_back (i);
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    StateMachineManager *manager = new StateMachineManager;
+    CHECK(PunctualFrameMover::timerService () == 0);
+    PunctualFrameMover::bindTimerService (&manager->timerService ());
+    CHECK(PunctualFrameMover::timerService () == &manager->timerService ());
+
+    PunctualFrameMover::registerTimedAction (2.0f, boost::bind (&fire, 2));
+    PunctualFrameMover::registerTimedAction (1.0f, boost::bind (&fire, 1));
+    timer_handle h = PunctualFrameMover::scheduleTimedAction (1.5f, boost::bind (&fire, 15));
+    TimedActionType *kept = PunctualFrameMover::registerTimedAction_cancelable (3.0f, boost::bind (&fire, 3));
+    TimedActionType *dropped = PunctualFrameMover::registerTimedAction_cancelable (3.0f, boost::bind (&fire, 30));
+    kept->retain ();
+    CHECK(kept && dropped);
+    CHECK(PunctualFrameMover::cancelTimedAction (h));
+    CHECK(!PunctualFrameMover::cancelTimedAction (h));
+
+    // time only moves by the manager, once per call
+    manager->pumpTimers (1.0);
+    CHECK(manager->timerService ().now () == 1.0);
+    CHECK(fired_.size () == 1 && fired_[0] == 1);
+    manager->pumpTimers (2.0);
+    CHECK(manager->timerService ().now () == 3.0);
+    CHECK(fired_.size () == 3 && fired_[1] == 2 && fired_[2] == 3);
+    kept->release ();
+
+    PunctualFrameMover::registerTimedAction (1.0f, boost::bind (&fire, 4));
+    PunctualFrameMover::clearTimedActions ();
+    manager->pumpTimers (1.0);
+    CHECK(fired_.size () == 3);
+
+    // machine timed events share the same clock
+    manager->setSharedTimers (true);
+    manager->set_scxml ("bell", bell_scxml);
+    StateMachine *bell = manager->getMach ("bell");
+    bell->StartEngine ();
+    bell->registerTimedEvent (1.0f, "ring");
+    bell->registerTimedEvent (5.0f, "ring");
+    manager->pumpTimers (1.0);
+    manager->pumpMachEvents ();
+    CHECK(bell->inState ("ringing"));
+
+    // a manager unbinds itself when deleted, machines with shared timers may outlive it in the autorelease pool
+    delete manager;
+    CHECK(PunctualFrameMover::timerService () == 0);
+    CHECK(!PunctualFrameMover::cancelTimedAction (h));
+
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,73 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+std::string counter_scxml = "\
+   <scxml> \
+       <state id='count'> \
+           <transition event='inc' target='count'/> \
+       </state> \
+    </scxml> \
+";
+
+std::vector<int> order_;
+StateMachine *other_ = 0;
+
+struct Counter
+{
+    int id_;
+    int entered_;
+    bool forward_;
+    Counter (int id) : id_(id), entered_(0), forward_(false) {}
+    void onentry ()
+    {
+        ++entered_;
+        order_.push_back (id_);
+        if (forward_ && entered_ > 1) other_->enqueEvent ("inc");
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("counter", counter_scxml);
+
+    Counter a (1), b (2);
+    StateMachine *ma = manager->getMach("counter");
+    StateMachine *mb = manager->getMach("counter");
+    ma->retain();
+    mb->retain();
+    ma->setActionSlot("onentry_count", make_slot (&Counter::onentry, &a));
+    mb->setActionSlot("onentry_count", make_slot (&Counter::onentry, &b));
+    ma->StartEngine();
+    mb->StartEngine();
+    order_.clear();
+
+    // a machine is pumped once per round with all its events, in order of its first event
+    mb->enqueEvent("inc");
+    ma->enqueEvent("inc");
+    mb->enqueEvent("inc");
+    mb->enqueEvent("inc");
+    manager->pumpMachEvents();
+    CHECK(order_.size() == 4 && order_[0] == 2 && order_[1] == 2 && order_[2] == 2 && order_[3] == 1);
+    CHECK(a.entered_ == 2 && b.entered_ == 4);
+
+    // events enqueued while pumping are handled by the same pumpMachEvents()
+    order_.clear();
+    a.forward_ = true;
+    other_ = mb;
+    ma->enqueEvent("inc");
+    manager->pumpMachEvents();
+    CHECK(order_.size() == 2 && order_[0] == 1 && order_[1] == 2);
+
+    ma->release();
+    mb->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
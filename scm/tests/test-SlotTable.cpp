@@ -0,0 +1,87 @@
+#include <scm/StateMachineManager.h>
+#include <scm/SlotTable.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string door_scxml = "\
+   <scxml> \
+       <state id='closed'> \
+           <transition event='open' cond='unlocked' target='opened'/> \
+       </state> \
+       <state id='opened'> \
+           <transition event='close' target='closed'/> \
+       </state> \
+    </scxml> \
+";
+
+int opened_ = 0;
+int custom_ = 0;
+bool unlocked_ = true;
+
+void onentry_opened () { ++opened_; }
+void custom () { ++custom_; }
+bool unlocked () { return unlocked_; }
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    SlotNames names;
+    CHECK(names.add ("a") == 0 && names.add ("b") == 1 && names.add ("a") == 0);
+    CHECK(names.size () == 2 && names.find ("b") == 1 && names.find ("c") == -1 && names.name (1) == "b");
+
+    // slots set before numbering are moved to their index, other names stay by name
+    SlotTable<action_slot> table;
+    table.set ("b", &custom);
+    table.set ("c", &custom);
+    table.bind_names (&names);
+    CHECK(table.find (0) == 0);
+    CHECK(table.find (1) != 0);
+    action_slot s;
+    CHECK(table.get ("c", s) && s);
+    CHECK(!table.get ("a", s));
+    table.set (0, &custom);
+    CHECK(table.find (0) != 0 && table.get ("a", s));
+
+    // renumbering keeps slots by name
+    SlotNames other;
+    other.add ("c");
+    other.add ("a");
+    table.bind_names (&other);
+    CHECK(table.find (0) != 0 && table.find (1) != 0);
+    CHECK(table.get ("b", s));
+    table.clear ();
+    CHECK(!table.get ("b", s) && table.find (0) == 0);
+
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("door", door_scxml);
+    StateMachine *mach = manager->getMach("door");
+    mach->retain();
+    mach->setActionSlot("onentry_opened", &onentry_opened);
+    mach->setActionSlot("not_in_scxml", &custom);
+    mach->setCondSlot("unlocked", &unlocked);
+    mach->StartEngine();
+
+    action_slot got;
+    CHECK(mach->GetActionSlot("not_in_scxml", got) && got);
+    got ();
+    CHECK(custom_ == 1);
+    CHECK(mach->GetActionSlot("onentry_opened", got));
+    CHECK(!mach->GetActionSlot("onexit_opened", got));
+
+    mach->enqueEvent("open");
+    manager->pumpMachEvents();
+    CHECK(opened_ == 1 && mach->inState("opened"));
+    unlocked_ = false;
+    mach->enqueEvent("close");
+    mach->enqueEvent("open");
+    manager->pumpMachEvents();
+    CHECK(opened_ == 1 && mach->inState("closed"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
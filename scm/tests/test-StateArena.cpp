@@ -0,0 +1,93 @@
+#include <scm/StateMachineManager.h>
+#include <scm/StateArena.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string tree_scxml = "\
+   <scxml> \
+       <state id='root'> \
+           <transition event='swap' target='other'/> \
+           <state id='leaf1'/> \
+           <state id='leaf2'/> \
+       </state> \
+       <state id='other'> \
+       </state> \
+    </scxml> \
+";
+
+int destructed_ = 0;
+
+struct Node: public ArenaObject
+{
+    double value_;
+
+    Node (double v)
+        : value_(v)
+    {
+    }
+    ~Node ()
+    {
+        ++destructed_;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    // allocations are aligned and handed out one after another
+    StateArena *arena = new StateArena (256);
+    char *a = static_cast<char *>(arena->allocate(1));
+    char *b = static_cast<char *>(arena->allocate(24));
+    CHECK(b > a && (size_t)(b - a) < 64);
+    CHECK((size_t)b % sizeof (void *) == 0);
+    CHECK(arena->allocated_size() >= 25);
+    char *big = static_cast<char *>(arena->allocate(1000)); // larger than a chunk
+    CHECK(big != 0);
+    big[999] = 1;
+
+    // objects retain their arena until deleted
+    int refs = arena->ref_count();
+    Node *n1 = new (arena) Node (1.5);
+    Node *n2 = new (arena) Node (2.5);
+    CHECK(arena->ref_count() == refs + 2);
+    CHECK(n1->value_ == 1.5 && n2->value_ == 2.5);
+    delete n1;
+    delete n2;
+    CHECK(destructed_ == 2);
+    CHECK(arena->ref_count() == refs);
+
+    // no arena, plain heap
+    Node *n3 = new Node (3.5);
+    CHECK(n3->value_ == 3.5);
+    delete n3;
+
+    // std containers in the arena
+    {
+        std::vector<int, ArenaAllocator<int> > v ((ArenaAllocator<int>(arena)));
+        for (int i=0; i < 100; ++i) {
+            v.push_back(i);
+        }
+        CHECK(v.size() == 100 && v[99] == 99);
+    }
+    arena->release();
+
+    // instance machines keep their states in an arena
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("tree", tree_scxml);
+    for (int i=0; i < 10; ++i) {
+        StateMachine *mach = manager->getMach("tree");
+        mach->retain();
+        mach->StartEngine();
+        mach->enqueEvent("swap");
+        manager->pumpMachEvents();
+        CHECK(mach->inState("other"));
+        mach->release();
+    }
+
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,77 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string player_scxml = "\
+   <scxml> \
+       <parallel id='playing'> \
+           <transition event='eject' target='empty'/> \
+           <state id='audio'> \
+               <state id='loud'> \
+                   <transition event='mute' target='muted'/> \
+               </state> \
+               <state id='muted'> \
+                   <transition event='unmute' target='loud'/> \
+               </state> \
+           </state> \
+           <state id='video'> \
+               <state id='moving'> \
+                   <transition event='pause' target='still'/> \
+               </state> \
+               <state id='still'> \
+                   <transition event='play' target='moving'/> \
+               </state> \
+           </state> \
+       </parallel> \
+       <state id='empty'> \
+       </state> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("player", player_scxml);
+
+    StateMachine *mach = manager->getMach("player");
+    mach->retain();
+    mach->StartEngine();
+
+    int mute = manager->event_id("mute");
+    int pause = manager->event_id("pause");
+    int eject = manager->event_id("eject");
+    State *audio = mach->getState("audio");
+    State *video = mach->getState("video");
+    State *playing = mach->getState("playing");
+
+    // a state only knows the events of its own subtree
+    CHECK(audio->handles_event(mute) && !audio->handles_event(pause));
+    CHECK(video->handles_event(pause) && !video->handles_event(mute));
+    CHECK(playing->handles_event(mute) && playing->handles_event(pause) && playing->handles_event(eject));
+    CHECK(!audio->handles_event(eject));
+    CHECK(mach->handles_event(mute) && mach->handles_event(eject));
+    int late = manager->event_id("interned_after_compile");
+    CHECK(!mach->handles_event(late));
+
+    // events still reach the region that handles them, and only that region
+    mach->enqueEvent(mute);
+    mach->enqueEvent(late);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("muted") && mach->inState("moving"));
+    mach->enqueEvent(pause);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("muted") && mach->inState("still"));
+
+    // a transition of an ancestor is taken from inside both regions
+    mach->enqueEvent(eject);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("empty") && !mach->inState("playing"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
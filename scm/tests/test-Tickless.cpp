@@ -0,0 +1,85 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string oven_scxml = "\
+   <scxml> \
+       <state id='idle'> \
+           <transition event='start' target='baking'/> \
+       </state> \
+       <state id='baking' frame_move='bake'> \
+           <transition event='done' target='idle'/> \
+       </state> \
+    </scxml> \
+";
+
+float baked_ = 0;
+int bake_calls_ = 0;
+
+void bake (float t)
+{
+    baked_ += t;
+    ++bake_calls_;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->setTickless(true);
+    CHECK(manager->tickless() && manager->sharedTimers());
+    manager->set_scxml("oven", oven_scxml);
+
+    StateMachine *idle = manager->getMach("oven");
+    StateMachine *oven = manager->getMach("oven");
+    idle->retain();
+    oven->retain();
+    idle->setFrameMoveSlot("bake", &bake);
+    oven->setFrameMoveSlot("bake", &bake);
+    idle->StartEngine();
+    oven->StartEngine();
+    manager->pumpMachEvents();
+
+    // nothing to do until a timed event is due
+    CHECK(idle->next_deadline() == no_deadline());
+    CHECK(manager->next_deadline() == no_deadline());
+    oven->registerTimedEvent(2.0f, "start");
+    CHECK(manager->next_deadline() == 2.0);
+    manager->tick(1.5);
+    CHECK(oven->inState("idle") && manager->next_deadline() == 0.5);
+    manager->tick(0.5);
+    CHECK(oven->inState("baking"));
+
+    // a machine with a frame_move slot is moved every tick, idle ones never
+    CHECK(oven->next_deadline() == 0 && manager->next_deadline() == 0);
+    int calls = bake_calls_;
+    manager->tick(0.25);
+    manager->tick(0.25);
+    CHECK(bake_calls_ == calls + 2 && baked_ >= 0.5f);
+    CHECK(idle->total_elapsed_time() == 0);
+
+    // events enqueued outside of tick() need wakeMach()
+    oven->enqueEvent("done");
+    CHECK(oven->next_deadline() == 0);
+    manager->tick(0);
+    CHECK(oven->inState("idle"));
+    calls = bake_calls_;
+    manager->tick(1.0);
+    CHECK(bake_calls_ == calls);
+    CHECK(manager->next_deadline() == no_deadline());
+
+    idle->enqueEvent("start");
+    manager->wakeMach(idle);
+    manager->tick(0.5);
+    CHECK(idle->inState("baking"));
+
+    // machines still scheduled or with shared timers may outlive the manager in the autorelease pool
+    oven->registerTimedEvent(10.0f, "start");
+    idle->release();
+    oven->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
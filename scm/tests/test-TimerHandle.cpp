@@ -0,0 +1,75 @@
+#include <scm/StateMachineManager.h>
+#include <scm/TimerQueue.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string alarm_scxml = "\
+   <scxml> \
+       <state id='idle'> \
+           <transition event='ring' target='ringing'/> \
+       </state> \
+       <state id='ringing'> \
+       </state> \
+    </scxml> \
+";
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    // a slot freed by pop or cancel is reused with another generation
+    TimerQueue<int> queue;
+    timer_handle h1 = queue.push (1.0, 1);
+    CHECK(h1 != 0 && queue.contains (h1));
+    queue.pop ();
+    CHECK(!queue.contains (h1));
+    timer_handle h2 = queue.push (1.0, 2);
+    CHECK(h2 != h1 && (h2 & 0xffffffffu) == (h1 & 0xffffffffu));
+    CHECK(!queue.cancel (h1));
+    CHECK(queue.contains (h2));
+    int value = 0;
+    CHECK(queue.cancel (h2, &value) && value == 2);
+    CHECK(!queue.cancel (h2) && queue.empty ());
+    CHECK(!queue.cancel (0));
+
+    timer_handle h3 = queue.push (3.0, 3);
+    timer_handle h4 = queue.push (4.0, 4);
+    timer_handle h5 = queue.push (5.0, 5);
+    CHECK(queue.cancel (h4));
+    CHECK(queue.top () == 3);
+    queue.pop ();
+    CHECK(queue.top () == 5 && queue.contains (h5) && !queue.contains (h3));
+    queue.clear ();
+    CHECK(!queue.contains (h5));
+
+    // canceled timed events of a machine are never sent
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("alarm", alarm_scxml);
+    StateMachine *mach = manager->getMach("alarm");
+    mach->retain();
+    mach->StartEngine();
+    timer_handle ring = mach->scheduleTimedEvent(1.0f, "ring");
+    CHECK(mach->cancelTimedEvent(ring));
+    CHECK(!mach->cancelTimedEvent(ring));
+    mach->frame_move(2.0f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("idle"));
+
+    // a stale handle doesn't cancel a newer event reusing its slot
+    timer_handle again = mach->scheduleTimedEvent(1.0f, "ring");
+    CHECK(!mach->cancelTimedEvent(ring));
+    timer_handle cleared = mach->scheduleTimedEvent(5.0f, "ring");
+    mach->frame_move(1.0f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("ringing"));
+    CHECK(!mach->cancelTimedEvent(again));
+    mach->clearTimedEvents();
+    CHECK(!mach->cancelTimedEvent(cleared));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,85 @@
+#include <scm/StateMachineManager.h>
+#include <scm/TimerQueue.h>
+#include "test_check.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+std::string relay_scxml = "\
+   <scxml> \
+       <state id='s0'> \
+           <transition event='e1' target='s1'/> \
+       </state> \
+       <state id='s1'> \
+           <transition event='e2' target='s2'/> \
+       </state> \
+       <state id='s2'> \
+           <transition event='e3' target='s3'/> \
+       </state> \
+       <state id='s3'> \
+       </state> \
+    </scxml> \
+";
+
+bool odd (int v) { return v % 2 != 0; }
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    // pops in order of time, same time in order of push
+    TimerQueue<int> queue;
+    srand (7);
+    for (int i=0; i < 200; ++i) {
+        queue.push (rand () % 20, i);
+    }
+    CHECK(queue.size () == 200);
+    double last_time = -1;
+    int last_value = -1;
+    bool ordered = true;
+    while (!queue.empty ()) {
+        double t = queue.top_time ();
+        int v = queue.top ();
+        if (t < last_time || (t == last_time && v < last_value)) ordered = false;
+        last_time = t;
+        last_value = v;
+        queue.pop ();
+    }
+    CHECK(ordered);
+
+    for (int i=0; i < 50; ++i) {
+        queue.push (50 - i, i);
+    }
+    queue.remove_if (&odd);
+    CHECK(queue.size () == 25);
+    CHECK(queue.top () == 48 && queue.top_time () == 2);
+    queue.clear ();
+    CHECK(queue.empty ());
+
+    // timed events of a machine are sent in order of time, not of registering
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("relay", relay_scxml);
+    StateMachine *mach = manager->getMach("relay");
+    mach->retain();
+    mach->StartEngine();
+    mach->registerTimedEvent(3.0f, "e3");
+    mach->registerTimedEvent(1.0f, "e1");
+    mach->registerTimedEvent(2.0f, "e2");
+    mach->frame_move(0.5f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("s0"));
+    mach->frame_move(1.0f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("s1"));
+    mach->frame_move(2.0f);
+    manager->pumpMachEvents();
+    CHECK(mach->inState("s3"));
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
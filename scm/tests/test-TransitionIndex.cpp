@@ -0,0 +1,81 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+using namespace std;
+using namespace scm;
+
+std::string door_scxml = "\
+   <scxml> \
+       <state id='closed'> \
+           <transition event='open' cond='locked' target='jammed'/> \
+           <transition event='knock' target='closed'/> \
+           <transition event='open' target='opened'/> \
+       </state> \
+       <state id='opened'> \
+           <transition event='close' target='closed'/> \
+       </state> \
+       <state id='jammed'> \
+       </state> \
+    </scxml> \
+";
+
+bool locked_ = false;
+
+bool locked ()
+{
+    return locked_;
+}
+
+StateMachine *start_door ()
+{
+    StateMachine *mach = StateMachineManager::instance()->getMach("door");
+    mach->setCondSlot("locked", &locked);
+    mach->StartEngine();
+    return mach;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("door", door_scxml);
+
+    StateMachine *mach = start_door();
+    mach->retain();
+
+    // transitions of one event are grouped in document order
+    ChartModel const *model = mach->model();
+    int closed = model->state_index("closed");
+    int open = manager->event_id("open");
+    ChartModel::transition_index_map const &index = model->transition_index(closed);
+    ChartModel::transition_index_map::const_iterator it = index.find(open);
+    CHECK(it != index.end());
+    if (it != index.end()) {
+        CHECK(it->second.second - it->second.first == 2);
+        TransitionAttr const *first = model->transitions(closed)[it->second.first];
+        TransitionAttr const *second = model->transitions(closed)[it->second.first + 1];
+        CHECK(first->event_ == "open" && first->cond_ == "locked");
+        CHECK(second->event_ == "open" && second->transition_target_ == "opened");
+    }
+    CHECK(index.find(manager->event_id("close")) == index.end());
+
+    // the first transition whose cond holds is taken
+    mach->enqueEvent("close"); // no transition in closed
+    mach->enqueEvent("knock");
+    mach->enqueEvent("open");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("opened"));
+    mach->release();
+
+    locked_ = true;
+    mach = start_door();
+    mach->retain();
+    mach->enqueEvent("open");
+    manager->pumpMachEvents();
+    CHECK(mach->inState("jammed"));
+    mach->release();
+
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
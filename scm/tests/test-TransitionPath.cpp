@@ -0,0 +1,89 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+#include <sstream>
+
+using namespace std;
+using namespace scm;
+
+std::string player_scxml = "\
+   <scxml> \
+       <state id='stopped'> \
+           <transition event='play' target='playing'/> \
+           <transition event='resume' target='hist'/> \
+       </state> \
+       <state id='active'> \
+           <history id='hist' type='shallow'/> \
+           <transition event='stop' target='stopped'/> \
+           <transition event='restart' target='active'/> \
+           <state id='playing'> \
+               <transition event='pause' target='paused'/> \
+           </state> \
+           <state id='paused'> \
+               <transition event='play' target='playing'/> \
+           </state> \
+       </state> \
+    </scxml> \
+";
+
+std::ostringstream log_;
+
+void entered (char const *s) { log_ << "+" << s << " "; }
+void exited (char const *s) { log_ << "-" << s << " "; }
+
+std::string take_log ()
+{
+    std::string s = log_.str ();
+    log_.str ("");
+    return s;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->set_scxml("player", player_scxml);
+
+    StateMachine *mach = manager->getMach("player");
+    mach->retain();
+    char const *ids[] = { "stopped", "active", "playing", "paused" };
+    for (size_t i=0; i < sizeof (ids) / sizeof (ids[0]); ++i) {
+        mach->setActionSlot(std::string ("onentry_") + ids[i], boost::bind (&entered, ids[i]));
+        mach->setActionSlot(std::string ("onexit_") + ids[i], boost::bind (&exited, ids[i]));
+    }
+    mach->StartEngine();
+    CHECK(take_log () == "+stopped ");
+
+    // fixed targets are resolved when the chart is compiled, history targets when taken
+    std::vector<TransitionAttr *> stopped = mach->transition_attr("stopped");
+    CHECK(stopped.size() == 2);
+    CHECK(stopped[0]->path_.lca_ == 0 && stopped[0]->path_.entry_.size() == 2);
+    CHECK(stopped[1]->path_.lca_ == -1);
+
+    mach->enqueEvent("play");
+    manager->pumpMachEvents();
+    CHECK(take_log () == "-stopped +active +playing ");
+
+    mach->enqueEvent("pause");
+    manager->pumpMachEvents();
+    CHECK(take_log () == "-playing +paused ");
+
+    mach->enqueEvent("stop");
+    manager->pumpMachEvents();
+    CHECK(take_log () == "-paused -active +stopped ");
+
+    // history restores paused, by the path found at run time
+    mach->enqueEvent("resume");
+    manager->pumpMachEvents();
+    CHECK(take_log () == "-stopped +active +paused ");
+
+    // a transition to its own source exits and enters it again, by its history
+    mach->enqueEvent("restart");
+    manager->pumpMachEvents();
+    CHECK(take_log () == "-paused -active +active +paused ");
+
+    mach->release();
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
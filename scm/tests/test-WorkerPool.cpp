@@ -0,0 +1,58 @@
+#include <scm/WorkerPool.h>
+#include "test_check.h"
+
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+struct Visit
+{
+    std::vector<int> *runs_;
+    Visit (std::vector<int> *runs) : runs_(runs) {}
+    void operator () (size_t i) const
+    {
+        // uneven work, so that threads done first steal from the others
+        volatile size_t spin = (i % 7 == 0) ? 20000 : 10;
+        while (spin) --spin;
+        ++(*runs_)[i];
+    }
+};
+
+bool each_once (WorkerPool &pool, size_t count)
+{
+    std::vector<int> runs (count, 0);
+    pool.run (count, Visit (&runs));
+    for (size_t i=0; i < count; ++i) {
+        if (runs[i] != 1) return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    WorkerPool pool;
+    CHECK(pool.size () == 0);
+    CHECK(each_once (pool, 0));
+    CHECK(each_once (pool, 100));
+
+    size_t threads[] = { 1, 3, 8 };
+    for (size_t t=0; t < sizeof (threads) / sizeof (threads[0]); ++t) {
+        pool.resize (threads[t]);
+#ifdef SCM_USE_THREADS
+        CHECK(pool.size () == threads[t]);
+#else
+        CHECK(pool.size () == 0);
+#endif
+        CHECK(each_once (pool, 0));
+        CHECK(each_once (pool, 1));
+        CHECK(each_once (pool, 5));
+        for (int round=0; round < 20; ++round) {
+            CHECK(each_once (pool, 1000 + round));
+        }
+    }
+    pool.resize (0);
+    CHECK(pool.size () == 0 && each_once (pool, 10));
+
+    return test_result();
+}
@@ -0,0 +1,94 @@
+#include <scm/StateMachineManager.h>
+#include "test_check.h"
+
+#include <vector>
+
+using namespace std;
+using namespace scm;
+
+std::string ping_scxml = "\
+   <scxml> \
+       <state id='ping'> \
+           <transition event='hit' target='pong'/> \
+       </state> \
+       <state id='pong'> \
+           <transition event='hit' target='ping'/> \
+       </state> \
+    </scxml> \
+";
+
+struct Player
+{
+    int hits_;
+    StateMachine *mach_;
+    StateMachine *next_;
+    Player () : hits_(0), mach_(0), next_(0) {}
+    void onentry_pong ()
+    {
+        ++hits_;
+        // delivered after the round when pumped by workers
+        if (next_) next_->enqueEvent ("hit");
+    }
+};
+
+// pumps n machines passing hits along, returns hits of each
+std::vector<int> play (size_t workers, size_t n)
+{
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->setWorkerThreads(workers);
+    manager->set_scxml("ping", ping_scxml);
+
+    std::vector<Player> players (n);
+    for (size_t i=0; i < n; ++i) {
+        players[i].mach_ = manager->getMach("ping");
+        players[i].mach_->retain();
+        players[i].mach_->set_allow_nop_entry_exit(true);
+        players[i].mach_->setActionSlot("onentry_pong", make_slot (&Player::onentry_pong, &players[i]));
+    }
+    for (size_t i=0; i + 1 < n; i += 2) {
+        players[i].next_ = players[i + 1].mach_;
+    }
+    for (size_t i=0; i < n; ++i) {
+        players[i].mach_->StartEngine();
+    }
+    for (int round=0; round < 10; ++round) {
+        for (size_t i=0; i < n; ++i) {
+            players[i].mach_->enqueEvent("hit");
+        }
+        manager->pumpMachEvents();
+    }
+
+    std::vector<int> hits;
+    for (size_t i=0; i < n; ++i) {
+        hits.push_back (players[i].hits_ * 10 + (players[i].mach_->inState("pong") ? 1 : 0));
+        players[i].mach_->release();
+    }
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return hits;
+}
+
+int main(int argc, char* argv[])
+{
+    AutoReleasePool apool;
+
+    std::vector<int> alone = play (0, 64);
+    std::vector<int> pooled = play (3, 64);
+    CHECK(alone == pooled);
+    // 10 hits each, odd players get 5 more forwarded: 5 and 8 times in pong
+    CHECK(alone[0] == 50 && alone[1] == 81);
+
+    StateMachineManager *manager = StateMachineManager::instance();
+    manager->setWorkerThreads(2);
+#ifdef SCM_USE_THREADS
+    CHECK(manager->workerThreads() == 2);
+#else
+    CHECK(manager->workerThreads() == 0);
+#endif
+    manager->setWorkerThreads(0);
+    CHECK(manager->workerThreads() == 0);
+
+    StateMachineManager::release_instance();
+    AutoReleasePool::pumpPools();
+    return test_result();
+}
@@ -0,0 +1,25 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+/** CHECK(cond) 在條件不成立時印出位置，main 最後傳回 test_result()。
+ * CHECK(cond) prints the location if cond doesn't hold, main returns test_result() at the end.
+ */
+static int test_failures_ = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+            ++test_failures_; \
+        } \
+    } while (0)
+
+inline int test_result ()
+{
+    std::cout << (test_failures_ ? "FAILED" : "passed") << std::endl;
+    return test_failures_ ? 1 : 0;
+}
+
+#endif